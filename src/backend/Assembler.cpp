@@ -1,8 +1,8 @@
 #include "Assembler.h"
 #include "MacroProcessor.h"
+#include "Lexer.h"
 #include <iomanip>
 #include <cstdint>
-#include <cstdint>
 #include <vector>
 #include <string>
 #include <sstream>
@@ -13,307 +13,288 @@ Assembler::Assembler() {
     startAddress = 0x100;
 }
 
-std::string Assembler::trim(const std::string& str) {
-    size_t first = str.find_first_not_of(" \t\r\n");
-    if (std::string::npos == first) return "";
-    size_t last = str.find_last_not_of(" \t\r\n");
-    return str.substr(first, (last - first + 1));
-}
-
-std::string normalizeLine(std::string line) {
-    std::string res = "";
-    bool inQuotes = false;
-    for (char c : line) {
-        if (c == '"') inQuotes = !inQuotes;
-        if (c == ',' && !inQuotes) res += " ";
-        else res += c;
-    }
-    return res;
-}
-
-std::string cleanToken(std::string t) {
-    if (!t.empty() && t.back() == ',') t.pop_back();
-    return t;
-}
-
-int parseNumber(std::string numStr) {
-    if (numStr.empty()) return 0;
-    try {
-        if (numStr.back() == 'h' || numStr.back() == 'H') {
-            numStr.pop_back();
-            return std::stoi(numStr, nullptr, 16);
-        }
-        return std::stoi(numStr);
-    } catch (...) { return 0; }
-}
-
-int getRegID(std::string r) {
-    if (r == "al" || r == "AL") return 0;
-    if (r == "ah" || r == "AH") return 1;
-    if (r == "bl" || r == "BL") return 2;
-    if (r == "bh" || r == "BH") return 3;
-    if (r == "cl" || r == "CL") return 4;
-    if (r == "ch" || r == "CH") return 5;
-    if (r == "dl" || r == "DL") return 6;
-    if (r == "dh" || r == "DH") return 7;
-    if (r == "ax" || r == "AX") return 0; 
-    if (r == "bx" || r == "BX") return 2;
-    if (r == "cx" || r == "CX") return 4;
-    if (r == "dx" || r == "DX") return 6;
-    return -1;
-}
-
-bool Assembler::pass1(const std::string& inputFile) {
-    std::ifstream inFile(inputFile);
-    if (!inFile.is_open()) return false;
-    
-    std::string line;
-    locationCounter = 0x100;
-    int dataCounter = 0x800; // Track strings/vars size
-    
-    while (std::getline(inFile, line)) {
-        line = trim(line);
-        if (line.empty() || line[0] == ';') continue;
-        
-        std::string norm = normalizeLine(line);
-        std::stringstream ss(norm);
-        std::string token; ss >> token;
-        if (token.empty()) continue;
-
-        if (token.back() == ':') {
-            symbolTable[token.substr(0, token.length() - 1)] = locationCounter;
-            ss >> token;
-        }
-        if (token.empty()) continue;
-
-        if (token[0] == '.') continue;
-        if (token == "main" || token == "endp" || token == "end" || token == "include") continue;
+// Single pass: encodes every line straight into the image. Operands naming a
+// symbol that is not defined yet get a zero placeholder and a fixup.
+bool Assembler::translate(ObjectImage& image, std::vector<Diagnostic>& diagnostics) {
+    locationCounter = startAddress;
+    int dataCounter = 0x800;
+    fixups.clear();
 
-        if (token == "org") { int val; ss >> std::hex >> val; locationCounter = val; }
-        else if (token == "mov") {
-            std::string d, s; ss >> d >> s;
-            if (getRegID(d) != -1 && getRegID(s) != -1) locationCounter += 3;
-            else locationCounter += 4;
-        }
-        else if (token == "add" || token == "sub" || token == "cmp") locationCounter += 4;
-        else if (token == "jmp" || token == "jz" || token == "jnz") locationCounter += 4;
-        else if (token == "int") locationCounter += 2;
-        else if (token == "push" || token == "pop" || token == "call" || token == "ret") locationCounter += 4;
-        else if (token == "print" || token == "printn") {
-            locationCounter += 3; 
-        }
-        else if (token == "mul" || token == "div") locationCounter += 3;
-        else if (token == "lea") locationCounter += 4;
-        else {
-            std::string next; ss >> next;
-            if (next == "db" || next == "DB") {
-                symbolTable[token] = 0; // Fixed up in pass2
+    image.clear();
+    image.entry = (uint16_t)startAddress;
+    auto emit = [&](int addr, std::initializer_list<int> bytes) {
+        uint8_t buf[8];
+        size_t n = 0;
+        for (int b : bytes) buf[n++] = (uint8_t)b;
+        image.emit((uint16_t)addr, buf, n);
+    };
+    // File of the line being translated, for diagnostics and the line table
+    const std::string* file = nullptr;
+    const std::string* indexedFile = nullptr;
+    uint16_t fileIndex = 0;
+    image.files.push_back(std::string()); // Main source, named by assembleSource
+    auto indexOf = [&](const std::string* f) -> uint16_t {
+        if (f == indexedFile) return fileIndex;
+        std::string name = sourceName(f);
+        auto it = std::find(image.files.begin(), image.files.end(), name);
+        if (it == image.files.end()) it = image.files.insert(it, name);
+        indexedFile = f;
+        fileIndex = (uint16_t)(it - image.files.begin());
+        return fileIndex;
+    };
+    auto macroOf = [&](std::string_view name) -> uint16_t {
+        if (name.empty()) return 0;
+        auto it = std::find(image.macros.begin(), image.macros.end(), name);
+        if (it == image.macros.end()) it = image.macros.insert(it, std::string(name));
+        return (uint16_t)(it - image.macros.begin() + 1);
+    };
+    auto define = [&](std::string_view name, int addr) {
+        symbolTable[symbols.intern(name)] = addr;
+    };
+    // Address of a symbol, or 0 plus a fixup on the 16-bit field at fieldAddr
+    auto symbolRef = [&](std::string_view name, int fieldAddr, int line) -> int {
+        uint32_t id = symbols.intern(name);
+        if (const int* addr = symbolTable.find(id)) return *addr;
+        fixups.push_back(Fixup{ fieldAddr, id, line, file });
+        return 0;
+    };
+    auto error = [&](int line, const std::string& msg) {
+        diagnostics.push_back(Diagnostic{ Diagnostic::Error, line, msg, sourceName(file) });
+    };
+    auto emitData = [&](const Token* values, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            const Token& v = values[i];
+            if (v.kind == TokenKind::Comma) continue;
+            if (v.kind == TokenKind::String && Lexer::stringContents(v).size() != 1) {
+                for (char c : Lexer::stringContents(v)) emit(dataCounter++, { (uint8_t)c });
+            } else {
+                // Number, character, or ? (initialized to 0 for safety)
+                emit(dataCounter++, { Lexer::valueOf(v) });
             }
         }
-    }
-    return true;
-}
-
-bool Assembler::pass2(const std::string& inputFile, const std::string& outputFile) {
-    std::ifstream inFile(inputFile);
-    std::ofstream outFile(outputFile);
-    if (!inFile.is_open() || !outFile.is_open()) return false;
+    };
 
-    std::string line;
-    locationCounter = 0x100;
-    int dataCounter = 0x800;
+    std::vector<Token> tokens;
+    std::vector<Token> ops;
+    for (const SourceLine& srcLine : lines) {
+        file = srcLine.file;
+        tokens.clear();
+        Lexer::tokenize(srcLine.text, tokens);
+        if (tokens.empty()) continue;
 
-    outFile << "ADDR CODE" << std::endl;
-
-    while (std::getline(inFile, line)) {
-        line = trim(line);
-        if (line.empty() || line[0] == ';') continue;
-        
-        std::string norm = normalizeLine(line);
-        // DB Handling
-        if (norm.find(" db ") != std::string::npos || norm.find(" DB ") != std::string::npos) {
-             std::stringstream ss(norm);
-             std::string label, type, valStr;
-             ss >> label >> type >> valStr;
-             if (type == "db" || type == "DB") {
-                 symbolTable[label] = dataCounter;
-                 if (!valStr.empty() && valStr[0] == '"') {
-                     // String literal
-                     size_t start = norm.find('"');
-                     size_t end = norm.find_last_of('"');
-                     if (start != std::string::npos && end != std::string::npos && end > start) {
-                         std::string content = norm.substr(start + 1, end - start - 1);
-                         for (char c : content) {
-                             outFile << std::hex << std::setw(4) << std::setfill('0') << dataCounter 
-                                     << " " << std::setw(2) << (int)(uint8_t)c << std::endl;
-                             dataCounter++;
-                         }
-                     }
-                 } else {
-                     // Number
-                     int val = parseNumber(valStr);
-                     outFile << std::hex << std::setw(4) << std::setfill('0') << dataCounter 
-                             << " " << std::setw(2) << (int)(uint8_t)val << std::endl;
-                     dataCounter++;
-                 }
-                 continue;
-             }
-        }
-        
-        // DB ? Handling
-        std::string dbCheck = norm;
-        size_t dbPos = dbCheck.find(" db ");
-        if (dbPos == std::string::npos) dbPos = dbCheck.find(" DB ");
-        if (dbPos != std::string::npos) {
-             std::stringstream ss(dbCheck);
-             std::string label, type, valStr;
-             ss >> label >> type >> valStr;
-             if ((type == "db" || type == "DB") && valStr == "?") {
-                 symbolTable[label] = dataCounter;
-                 // Initialize to 0 for safety
-                 outFile << std::hex << std::setw(4) << std::setfill('0') << dataCounter 
-                         << " " << std::setw(2) << 0 << std::endl;
-                 dataCounter++;
-                 continue;
-             }
+        size_t first = 0;
+        if (tokens[0].kind == TokenKind::Label) {
+            define(tokens[0].text, locationCounter);
+            first = 1;
         }
+        if (first == tokens.size()) continue;
+        const Token& head = tokens[first];
+        if (head.kind != TokenKind::Identifier || head.text[0] == '.') continue;
 
-        size_t colon = line.find(':');
-        if (colon != std::string::npos) line = trim(line.substr(colon + 1));
-        if (line.empty()) continue;
-
-        std::stringstream ss(normalizeLine(line));
-        std::string opcode;
-        ss >> opcode;
-        if (opcode[0] == '.' || opcode == "main" || opcode == "endp" || opcode == "end" || opcode == "include") continue;
-
-        if (opcode == "org") { int val; ss >> std::hex >> val; locationCounter = val; continue; }
+        // Operands without the separating commas
+        ops.clear();
+        for (size_t i = first + 1; i < tokens.size(); i++) {
+            if (tokens[i].kind != TokenKind::Comma) ops.push_back(tokens[i]);
+        }
+        auto regOf = [&](size_t i) -> int { return (i < ops.size() && ops[i].isRegister()) ? ops[i].keyword->value : -1; };
+        auto symbolAt = [&](size_t i) -> bool { return i < ops.size() && ops[i].isSymbol(); };
+        auto wordAt = [&](size_t i) -> bool { return i < ops.size() && ops[i].is16(); };
 
-        if (opcode == "mov") {
-            std::string destStr, srcStr; ss >> destStr >> srcStr;
-            int dest = getRegID(destStr), src = getRegID(srcStr);
+        int lineStart = locationCounter;
+        switch (head.keyword ? head.keyword->id : Keyword::None) {
+        case Keyword::End: case Keyword::Endp: case Keyword::Include: case Keyword::Proc:
+            break;
+        case Keyword::Org:
+            if (!ops.empty()) locationCounter = Lexer::valueOf(ops[0], 16);
+            break;
+        case Keyword::Db:
+            emitData(tokens.data() + first + 1, tokens.size() - first - 1);
+            break;
+        case Keyword::Mov: {
+            int dest = regOf(0), src = regOf(1);
+            // Naming a 16-bit register selects the word form of each encoding
+            int w = (wordAt(0) || wordAt(1)) ? WORD_OPCODE : 0;
             if (src != -1 && dest != -1) {
-                outFile << std::hex << std::setw(4) << std::setfill('0') << locationCounter << " 02 " 
-                        << std::setw(2) << (int)(uint8_t)dest << " " << std::setw(2) << (int)(uint8_t)src << std::endl;
+                if (wordAt(0) != wordAt(1)) { error(srcLine.line, "Operand size mismatch for mov"); break; }
+                emit(locationCounter, { 0x02 | w, dest, src });
                 locationCounter += 3;
-            } else if (dest != -1) {
-                if (symbolTable.count(srcStr)) {
-                    int addr = symbolTable[srcStr];
-                    outFile << std::hex << std::setw(4) << std::setfill('0') << locationCounter << " 05 " 
-                            << std::setw(2) << (int)(uint8_t)dest << " " << std::setw(2) << (int)(uint8_t)(addr&0xFF) 
-                            << " " << std::setw(2) << (int)(uint8_t)((addr>>8)&0xFF) << std::endl;
-                    locationCounter += 4;
-                } else {
-                    int val = parseNumber(srcStr);
-                    outFile << std::hex << std::setw(4) << std::setfill('0') << locationCounter << " 01 " 
-                            << std::setw(2) << (int)(uint8_t)dest << " " << std::setw(2) << (int)(uint8_t)(val & 0xFF) 
-                            << " " << std::setw(2) << (int)(uint8_t)((val >> 8) & 0xFF) << std::endl;
-                    locationCounter += 4;
-                }
-            } else if (src != -1 && symbolTable.count(destStr)) {
-                int addr = symbolTable[destStr];
-                outFile << std::hex << std::setw(4) << std::setfill('0') << locationCounter << " 06 " 
-                        << std::setw(2) << (int)(uint8_t)(addr&0xFF) << " " << std::setw(2) << (int)(uint8_t)((addr>>8)&0xFF) 
-                        << " " << std::setw(2) << (int)(uint8_t)src << std::endl;
+            } else if (dest != -1 && symbolAt(1)) {
+                int addr = symbolRef(ops[1].text, locationCounter + 2, srcLine.line);
+                emit(locationCounter, { 0x05 | w, dest, addr & 0xFF, (addr >> 8) & 0xFF });
+                locationCounter += 4;
+            } else if (dest != -1 && ops.size() > 1) {
+                int val = Lexer::valueOf(ops[1]);
+                emit(locationCounter, { 0x01 | w, dest, val & 0xFF, (val >> 8) & 0xFF });
                 locationCounter += 4;
+            } else if (src != -1 && symbolAt(0)) {
+                int addr = symbolRef(ops[0].text, locationCounter + 1, srcLine.line);
+                emit(locationCounter, { 0x06 | w, addr & 0xFF, (addr >> 8) & 0xFF, src });
+                locationCounter += 4;
+            } else {
+                error(srcLine.line, "Invalid operands for mov");
             }
+            break;
         }
-        else if (opcode == "add" || opcode == "sub" || opcode == "cmp") {
-            std::string destStr, srcStr; ss >> destStr >> srcStr;
-            int dest = getRegID(destStr), srcID = getRegID(srcStr);
-            int op = (opcode == "add") ? 3 : (opcode == "sub") ? 4 : 7;
-            if (srcID != -1) outFile << std::hex << std::setw(4) << std::setfill('0') << locationCounter << " 0" << op << " " << std::setw(2) << (int)(uint8_t)dest << " 01 " << std::setw(2) << (int)(uint8_t)srcID << std::endl;
+        case Keyword::Add: case Keyword::Sub: case Keyword::Cmp: {
+            int dest = regOf(0), srcID = regOf(1);
+            int op = head.keyword->value;
+            if (dest == -1 || ops.size() < 2) { error(srcLine.line, "Invalid operands for " + std::string(head.text)); break; }
+            if (srcID != -1 && wordAt(0) != wordAt(1)) {
+                error(srcLine.line, "Operand size mismatch for " + std::string(head.text));
+                break;
+            }
+            if (wordAt(0)) {
+                // Word form: OP REG TYPE LO HI, with a 16-bit immediate
+                int val = srcID != -1 ? srcID : Lexer::valueOf(ops[1]);
+                emit(locationCounter, { op | WORD_OPCODE, dest, srcID != -1 ? 0x01 : 0x02, val & 0xFF, (val >> 8) & 0xFF });
+                locationCounter += 5;
+                break;
+            }
+            if (srcID != -1) emit(locationCounter, { op, dest, 0x01, srcID });
             else {
-                 int val = parseNumber(srcStr);
-                 outFile << std::hex << std::setw(4) << std::setfill('0') << locationCounter << " 0" << op << " " << std::setw(2) << (int)(uint8_t)dest << " 02 " << std::setw(2) << (int)(uint8_t)(val&0xFF) << std::endl;
+                 int val = Lexer::valueOf(ops[1]);
+                 emit(locationCounter, { op, dest, 0x02, val & 0xFF });
             }
             locationCounter += 4; 
+            break;
         }
-        else if (opcode == "mul" || opcode == "div") {
-            std::string srcStr; ss >> srcStr;
-            int srcID = getRegID(srcStr);
-            int op = (opcode == "mul") ? 0x50 : 0x51;
-            // Format: ADDR OP REG 00 (REG is src)
-            if (srcID != -1) {
-                outFile << std::hex << std::setw(4) << std::setfill('0') << locationCounter << " " << op << " " << std::setw(2) << (int)(uint8_t)srcID << " 00" << std::endl;
-                locationCounter += 3;
-            }
+        case Keyword::Mul: case Keyword::Div: {
+            int srcID = regOf(0);
+            // Format: OP REG 00 (REG is src)
+            if (srcID == -1) { error(srcLine.line, std::string(head.text) + " requires a register operand"); break; }
+            emit(locationCounter, { head.keyword->value, srcID, 0x00 });
+            locationCounter += 3;
+            break;
         }
-        else if (opcode == "lea") {
-            std::string destStr, srcStr; ss >> destStr >> srcStr; // source is variable name
-            int destID = getRegID(destStr);
-            if (destID != -1 && symbolTable.count(srcStr)) {
-                int addr = symbolTable[srcStr];
-                outFile << std::hex << std::setw(4) << std::setfill('0') << locationCounter << " 15 " 
-                        << std::setw(2) << (int)(uint8_t)destID << " " 
-                        << std::setw(2) << (int)(uint8_t)(addr&0xFF) << " " 
-                        << std::setw(2) << (int)(uint8_t)((addr>>8)&0xFF) << std::endl;
-                locationCounter += 4;
-            }
+        case Keyword::Lea: {
+            int destID = regOf(0); // source is variable name
+            if (destID == -1 || !symbolAt(1)) { error(srcLine.line, "Invalid operands for lea"); break; }
+            int addr = symbolRef(ops[1].text, locationCounter + 2, srcLine.line);
+            emit(locationCounter, { 0x15, destID, addr & 0xFF, (addr >> 8) & 0xFF });
+            locationCounter += 4;
+            break;
         }
-        else if (opcode == "jmp" || opcode == "jz" || opcode == "jnz") {
-            int op = (opcode == "jmp") ? 0x40 : (opcode == "jz") ? 0x41 : 0x42;
-            std::string lbl; ss >> lbl;
-            int addr = symbolTable.count(lbl) ? symbolTable[lbl] : 0;
-            outFile << std::hex << std::setw(4) << std::setfill('0') << locationCounter << " " << std::hex << op << " 02 " << std::setw(2) << (addr&0xFF) << " " << std::setw(2) << ((addr>>8)&0xFF) << std::endl;
+        case Keyword::Jmp: case Keyword::Jz: case Keyword::Jnz: case Keyword::Jcc: case Keyword::Call: {
+            if (!symbolAt(0)) { error(srcLine.line, std::string(head.text) + " requires a label"); break; }
+            int addr = symbolRef(ops[0].text, locationCounter + 2, srcLine.line);
+            emit(locationCounter, { head.keyword->value, 0x02, addr & 0xFF, (addr >> 8) & 0xFF });
             locationCounter += 4;
+            break;
         }
-        else if (opcode == "int") {
-            std::string arg; ss >> arg; int val = parseNumber(arg);
-            outFile << std::hex << std::setw(4) << std::setfill('0') << locationCounter << " 10 " << std::setw(2) << (int)(uint8_t)val << std::endl;
+        case Keyword::Int: {
+            int val = ops.empty() ? 0 : Lexer::valueOf(ops[0]);
+            emit(locationCounter, { 0x10, val });
             locationCounter += 2;
+            break;
         }
-        else if (opcode == "print" || opcode == "printn") {
-            std::string str;
-            std::getline(ss, str);
-            size_t start = str.find('"');
-            size_t end = str.find_last_of('"');
-            if (start != std::string::npos && end != std::string::npos && end > start) {
-                std::string content = str.substr(start + 1, end - start - 1);
-                int strAddr = dataCounter;
-                // Emit PRINTN instruction
-                outFile << std::hex << std::setw(4) << std::setfill('0') << locationCounter << " 20 " 
-                        << std::setw(2) << (int)(uint8_t)(strAddr&0xFF) << " " << std::setw(2) << (int)(uint8_t)((strAddr>>8)&0xFF) << std::endl;
-                
-                // Emit String Data at dataCounter
-                std::string oldHex = ""; // For debugging
-                for (char c : content) {
-                    outFile << std::hex << std::setw(4) << std::setfill('0') << dataCounter << " " << std::setw(2) << (int)(uint8_t)c << std::endl;
-                    dataCounter++;
-                }
-                outFile << std::hex << std::setw(4) << std::setfill('0') << dataCounter << " 00" << std::endl; // Null terminator
-                dataCounter++;
+        case Keyword::Print: case Keyword::Printn: {
+            if (ops.empty() || ops[0].kind != TokenKind::String) break;
+            int strAddr = dataCounter;
+            // Emit PRINTN instruction
+            emit(locationCounter, { 0x20, strAddr & 0xFF, (strAddr >> 8) & 0xFF });
 
-                locationCounter += 3;
-            }
+            // Emit String Data at dataCounter
+            for (char c : Lexer::stringContents(ops[0])) emit(dataCounter++, { (uint8_t)c });
+            emit(dataCounter++, { 0 }); // Null terminator
+
+            locationCounter += 3;
+            break;
         }
-        else if (opcode == "push" || opcode == "pop" || opcode == "call" || opcode == "ret") {
-            int op = (opcode == "push") ? 0x30 : (opcode == "pop") ? 0x31 : (opcode == "call") ? 0x32 : 0x33;
-            std::string arg; ss >> arg;
-            if (op == 0x33) {
-                outFile << std::hex << std::setw(4) << std::setfill('0') << locationCounter << " 33 00 00 00" << std::endl;
-            } else if (op == 0x32) {
-                int addr = symbolTable.count(arg) ? symbolTable[arg] : 0;
-                outFile << std::hex << std::setw(4) << std::setfill('0') << locationCounter << " 32 02 " << std::setw(2) << (addr&0xFF) << " " << std::setw(2) << ((addr>>8)&0xFF) << std::endl;
+        case Keyword::Push: case Keyword::Pop: {
+            int type = (regOf(0) != -1) ? 1 : 2;
+            int val = (type == 1) ? regOf(0) : (ops.empty() ? 0 : Lexer::valueOf(ops[0]));
+            emit(locationCounter, { head.keyword->value, type, val & 0xFF, (val >> 8) & 0xFF });
+            locationCounter += 4;
+            break;
+        }
+        case Keyword::Ret: case Keyword::Pushf: case Keyword::Popf:
+            emit(locationCounter, { head.keyword->value, 0x00, 0x00, 0x00 });
+            locationCounter += 4;
+            break;
+        default: {
+            // NAME PROC / NAME ENDP / NAME DB value
+            const Token* next = (first + 1 < tokens.size()) ? &tokens[first + 1] : nullptr;
+            if (head.isSymbol() && next && next->is(Keyword::Proc)) {
+                define(head.text, locationCounter);
+            } else if (head.isSymbol() && next && next->is(Keyword::Endp)) {
+                break;
+            } else if (head.isSymbol() && next && next->is(Keyword::Db)) {
+                define(head.text, dataCounter);
+                emitData(tokens.data() + first + 2, tokens.size() - first - 2);
             } else {
-                int type = (getRegID(arg) != -1) ? 1 : 2;
-                int val = (type == 1) ? getRegID(arg) : parseNumber(arg);
-                outFile << std::hex << std::setw(4) << std::setfill('0') << locationCounter << " " << std::hex << op << " " << std::setw(2) << type << " " << std::setw(2) << (val&0xFF) << std::endl;
+                diagnostics.push_back(Diagnostic{ Diagnostic::Warning, srcLine.line, "Unknown instruction '" + std::string(head.text) + "' ignored", sourceName(file) });
             }
-            locationCounter += 4;
+            break;
         }
+        }
+        if (locationCounter != lineStart && !head.is(Keyword::Org)) {
+            image.lines.push_back(LineEntry{ (uint16_t)lineStart, indexOf(file), (uint32_t)srcLine.line,
+                                             macroOf(srcLine.macro), (uint16_t)srcLine.macroLine });
+        }
+    }
+    // ORG can move code backwards
+    std::stable_sort(image.lines.begin(), image.lines.end(),
+                     [](const LineEntry& a, const LineEntry& b) { return a.address < b.address; });
+
+    return resolveFixups(image, diagnostics);
+}
+
+bool Assembler::resolveFixups(ObjectImage& image, std::vector<Diagnostic>& diagnostics) {
+    bool ok = true;
+    for (const Fixup& f : fixups) {
+        const int* addr = symbolTable.find(f.symbol);
+        if (!addr) {
+            diagnostics.push_back(Diagnostic{ Diagnostic::Error, f.line, "Undefined symbol '" + std::string(symbols.name(f.symbol)) + "'", sourceName(f.file) });
+            ok = false;
+            continue;
+        }
+        image.patch16((uint16_t)f.fieldAddr, (uint16_t)*addr);
     }
-    return true;
+
+    image.symbols.reserve(symbolTable.size());
+    symbolTable.forEach([&](uint32_t id, int addr) {
+        image.symbols.push_back(ObjectSymbol{ std::string(symbols.name(id)), (uint16_t)addr });
+    });
+    std::sort(image.symbols.begin(), image.symbols.end(),
+              [](const ObjectSymbol& a, const ObjectSymbol& b) { return a.address < b.address; });
+    return ok;
 }
 
-bool Assembler::assemble(const std::string& inputFile, const std::string& outputFile) {
+AssemblyResult Assembler::assembleSource(const std::string& source, const std::string& sourcePath) {
+    AssemblyResult result;
+    result.success = false;
+    symbolTable.clear();
+    symbols.clear();
+    lines.clear();
+
     MacroProcessor mp;
-    std::string expandedFile = "temp_expanded.asm";
-    if (!mp.expandMacros(inputFile, expandedFile)) {
-        // Fallback if macro processor fails
-        expandedFile = inputFile;
+    if (mp.expand(source, lines, result.diagnostics, sourcePath)) {
+        // Labels are at most one per line; most programs have far fewer
+        symbolTable.reserve(lines.size() / 4);
+        symbols.reserve(lines.size() / 4);
+        result.success = translate(result.image, result.diagnostics);
+        result.image.files[0] = sourcePath; // Tools name lines without being told the source
+    }
+    for (const Diagnostic& d : result.diagnostics) {
+        if (d.severity == Diagnostic::Error) result.success = false;
+    }
+    return result;
+}
+
+bool Assembler::assemble(const std::string& inputFile, const std::string& outputFile, const std::string& listingFile) {
+    std::ifstream inFile(inputFile, std::ios::binary);
+    if (!inFile.is_open()) {
+        std::cerr << "Error: Could not open " << inputFile << std::endl;
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << inFile.rdbuf();
+
+    AssemblyResult result = assembleSource(buffer.str(), inputFile);
+    for (const Diagnostic& d : result.diagnostics) {
+        std::cerr << formatDiagnostic(d, inputFile) << std::endl;
     }
-    if (!pass1(expandedFile)) return false;
-    return pass2(expandedFile, outputFile);
+    if (!result.success) return false;
+    if (!result.image.writeBinary(outputFile)) return false;
+    return listingFile.empty() || result.image.writeListing(listingFile);
 }
-void Assembler::initOpcodeTable() {}
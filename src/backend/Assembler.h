@@ -9,14 +9,26 @@
 #include <sstream>
 #include <algorithm>
 #include <iomanip>
+#include "ObjectImage.h"
+#include "Source.h"
+#include "StringInterner.h"
+#include "FlatHashMap.h"
+
+// Output of one in-memory assembly
+struct AssemblyResult {
+    bool success;
+    ObjectImage image;
+    std::vector<Diagnostic> diagnostics;
+};
 
 class Assembler {
 private:
-    // Opcode Table: Maps mnemonics to their opcode values (and instruction format info if needed)
-    std::map<std::string, std::pair<std::string, int>> opcodeTable;
+    // Symbol names interned once; everything else refers to them by ID.
+    // Mnemonics, registers and directives live in the constexpr table in Lexer.h.
+    StringInterner symbols;
 
-    // Symbol Table: Maps labels to their memory addresses
-    std::map<std::string, int> symbolTable;
+    // Symbol Table: Maps label IDs to their memory addresses
+    FlatHashMap<uint32_t, int> symbolTable;
 
     // Current location counter
     int locationCounter;
@@ -24,24 +36,36 @@ private:
     // Starting address of the program
     int startAddress;
 
-    // Helper to initialize opcodes
-    void initOpcodeTable();
+    // Macro-expanded source read by the translation pass
+    std::vector<SourceLine> lines;
+
+    // Forward reference: 16-bit address field to patch once symbol is known
+    struct Fixup {
+        int fieldAddr;
+        uint32_t symbol;
+        int line;
+        const std::string* file;
+    };
+    std::vector<Fixup> fixups;
 
     // Helper methods
-    std::string trim(const std::string& str);
     std::vector<std::string> split(const std::string& str);
     bool isLabel(const std::string& token);
     bool isComment(const std::string& line);
 
-    // Pass 1: Define symbols
-    bool pass1(const std::string& inputFile);
+    // Single pass: define symbols and generate object code into the image
+    bool translate(ObjectImage& image, std::vector<Diagnostic>& diagnostics);
 
-    // Pass 2: Generate object code
-    bool pass2(const std::string& inputFile, const std::string& outputFile);
+    // Patch forward references; reports symbols that were never defined
+    bool resolveFixups(ObjectImage& image, std::vector<Diagnostic>& diagnostics);
 
 public:
     Assembler();
-    bool assemble(const std::string& inputFile, const std::string& outputFile);
+    // Assembles source text; only INCLUDE directives read files, looked up
+    // next to sourcePath first
+    AssemblyResult assembleSource(const std::string& source, const std::string& sourcePath = "");
+    // File wrapper: reads inputFile, writes the binary image and optional listing
+    bool assemble(const std::string& inputFile, const std::string& outputFile, const std::string& listingFile = "");
 };
 
 #endif
@@ -0,0 +1,173 @@
+#include "BatchRunner.h"
+#include "Assembler.h"
+#include "Tracer.h"
+#include "WorkStealingPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+static bool readFile(const fs::path& path, std::string& text) {
+    std::ifstream inFile(path, std::ios::binary);
+    if (!inFile.is_open()) return false;
+    std::stringstream buffer;
+    buffer << inFile.rdbuf();
+    text = buffer.str();
+    return true;
+}
+
+static void writeJsonString(std::ostream& os, const std::string& s) {
+    os << '"';
+    for (unsigned char c : s) {
+        switch (c) {
+            case '"': os << "\\\""; break;
+            case '\\': os << "\\\\"; break;
+            case '\n': os << "\\n"; break;
+            case '\r': os << "\\r"; break;
+            case '\t': os << "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    os << buf;
+                } else {
+                    os << c;
+                }
+        }
+    }
+    os << '"';
+}
+
+BatchRunner::BatchRunner(Engine engine, unsigned threads)
+    : engine(engine), threads(threads), cycleLimit(5000), timeLimit(0), traceEntries(0) {}
+
+void BatchRunner::setLimits(int cycles, double seconds) {
+    cycleLimit = cycles;
+    timeLimit = seconds;
+}
+
+void BatchRunner::setTrace(size_t entries, const std::string& directory) {
+    traceEntries = entries;
+    traceDirectory = directory;
+}
+
+bool BatchRunner::collect(const std::string& source, std::vector<std::string>& files) {
+    std::error_code ec;
+    if (fs::is_directory(source, ec)) {
+        for (const fs::directory_entry& entry : fs::directory_iterator(source, ec)) {
+            if (entry.is_regular_file(ec) && entry.path().extension() == ".asm") {
+                files.push_back(entry.path().string());
+            }
+        }
+        std::sort(files.begin(), files.end());
+        return !ec;
+    }
+
+    std::string manifest;
+    if (!readFile(source, manifest)) return false;
+    fs::path base = fs::path(source).parent_path();
+    std::istringstream lines(manifest);
+    std::string line;
+    while (std::getline(lines, line)) {
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') continue;
+        size_t last = line.find_last_not_of(" \t\r");
+        fs::path path(line.substr(first, last - first + 1));
+        files.push_back((path.is_relative() ? base / path : path).string());
+    }
+    return true;
+}
+
+BatchResult BatchRunner::runOne(const std::string& file) const {
+    auto start = std::chrono::steady_clock::now();
+    BatchResult result;
+    result.file = file;
+    result.cycles = 0;
+    result.mips = 0;
+
+    std::string source;
+    if (!readFile(file, source)) {
+        result.status = "read_error";
+    } else {
+        Assembler assembler;
+        AssemblyResult assembled = assembler.assembleSource(source, file);
+        for (const Diagnostic& d : assembled.diagnostics) {
+            result.diagnostics += formatDiagnostic(d, file) + "\n";
+        }
+
+        if (!assembled.success) {
+            result.status = "assembly_error";
+        } else {
+            std::string input;
+            readFile(fs::path(file).replace_extension(".in"), input); // Optional
+            ScriptedDevice console(input); // Output captured in memory
+
+            Simulator cpu;
+            cpu.setDevice(console);
+            cpu.setCycleLimit(cycleLimit);
+            cpu.setTimeLimit(timeLimit);
+            std::unique_ptr<Tracer> tracer;
+            if (traceEntries) {
+                tracer.reset(new Tracer(traceEntries));
+                cpu.setTracer(tracer.get());
+            }
+            if (!cpu.loadImage(assembled.image)) {
+                result.status = "load_error";
+            } else {
+                cpu.run(false, engine);
+                RunStats stats = cpu.stats();
+                result.status = stats.termination == Termination::Exit ? "ok" : terminationName(stats.termination);
+                result.cycles = stats.instructions;
+                result.mips = stats.mips();
+                if (stats.termination == Termination::InvalidOpcode || stats.termination == Termination::DivideError) {
+                    char fault[64];
+                    std::snprintf(fault, sizeof(fault), "runtime: %s at %04X (opcode %02X)\n",
+                                  result.status.c_str(), stats.faultIP, stats.faultOpcode);
+                    result.diagnostics += fault;
+                }
+                if (tracer && stats.termination != Termination::Exit) {
+                    fs::path path = fs::path(traceDirectory) / fs::path(file).filename().replace_extension(".trace");
+                    if (tracer->dump(path.string(), stats, traceEntries)) result.trace = path.string();
+                    else result.diagnostics += "trace: could not write " + path.string() + "\n";
+                }
+            }
+            result.output = std::move(console.output());
+        }
+    }
+
+    result.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+std::vector<BatchResult> BatchRunner::run(const std::vector<std::string>& files) const {
+    std::vector<BatchResult> results(files.size());
+    WorkStealingPool pool(threads);
+    pool.run(files.size(), [&](size_t i) { results[i] = runOne(files[i]); });
+    return results;
+}
+
+bool BatchRunner::writeResults(const std::string& path, const std::vector<BatchResult>& results) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out.is_open()) return false;
+    for (const BatchResult& r : results) {
+        out << "{\"file\":";
+        writeJsonString(out, r.file);
+        out << ",\"status\":";
+        writeJsonString(out, r.status);
+        out << ",\"cycles\":" << r.cycles << ",\"ms\":" << r.milliseconds << ",\"mips\":" << r.mips << ",\"output\":";
+        writeJsonString(out, r.output);
+        out << ",\"diagnostics\":";
+        writeJsonString(out, r.diagnostics);
+        if (!r.trace.empty()) {
+            out << ",\"trace\":";
+            writeJsonString(out, r.trace);
+        }
+        out << "}\n";
+    }
+    return (bool)out;
+}
@@ -0,0 +1,60 @@
+#ifndef BATCHRUNNER_H
+#define BATCHRUNNER_H
+
+#include <string>
+#include <vector>
+#include "Simulator.h"
+
+// Outcome of assembling and running one source file
+struct BatchResult {
+    std::string file;
+    // ok (INT 21h/4Ch), cycle_limit, time_limit, invalid_opcode, divide_error,
+    // read_error, assembly_error or load_error
+    std::string status;
+    std::string diagnostics; // Assembler messages and runtime faults, one per line
+    std::string output;      // Everything the program printed
+    std::string trace;       // Trace file written for the run, if any
+    int cycles;
+    double milliseconds;     // Assemble + run wall time
+    double mips;             // Simulation speed
+};
+
+// Assembles and simulates many sources in one process, one Assembler and
+// Simulator per job, spread over a work-stealing pool. Nothing touches the
+// filesystem except reading the sources, their .in files and includes, and
+// writing traces when enabled.
+class BatchRunner {
+private:
+    Engine engine;
+    unsigned threads;
+    int cycleLimit;
+    double timeLimit;
+    size_t traceEntries;
+    std::string traceDirectory;
+
+    BatchResult runOne(const std::string& file) const;
+
+public:
+    // threads == 0 uses every hardware thread
+    BatchRunner(Engine engine = Engine::Switch, unsigned threads = 0);
+    // Per program, as Simulator::setCycleLimit and setTimeLimit
+    void setLimits(int cycles, double seconds);
+    // Traces every program's last entries instructions; runs that do not
+    // end with INT 21h/4Ch dump theirs to directory/<source name>.trace.
+    // entries == 0 turns tracing off.
+    void setTrace(size_t entries, const std::string& directory);
+
+    // A directory yields its .asm files in name order; any other file is a
+    // manifest listing one source path per line, relative to the manifest.
+    static bool collect(const std::string& source, std::vector<std::string>& files);
+
+    // Results come back in the order of files. A program's console input is
+    // read byte for byte from the file next to it with the extension
+    // replaced by .in.
+    std::vector<BatchResult> run(const std::vector<std::string>& files) const;
+
+    // JSON Lines: one object per result
+    static bool writeResults(const std::string& path, const std::vector<BatchResult>& results);
+};
+
+#endif
@@ -0,0 +1,311 @@
+#include "BlockEngine.h"
+#include "ThreadedEngine.h"
+
+#define TITAN_UOP(op) \
+    template <> bool BlockEngine::exec<DecodedOp::op>([[maybe_unused]] Simulator& s, [[maybe_unused]] const Uop& u)
+
+// Straight-line ops: never leave the block
+TITAN_UOP(Nop) { return true; }
+TITAN_UOP(MovRI) { *u.dst = (uint8_t)u.imm; return true; }
+TITAN_UOP(MovRR) { *u.dst = *u.src; return true; }
+TITAN_UOP(AddRI) { *u.dst = s.flags.add8(*u.dst, (uint8_t)u.imm); return true; }
+TITAN_UOP(AddRR) { *u.dst = s.flags.add8(*u.dst, *u.src); return true; }
+TITAN_UOP(SubRI) { *u.dst = s.flags.sub8(*u.dst, (uint8_t)u.imm); return true; }
+TITAN_UOP(SubRR) { *u.dst = s.flags.sub8(*u.dst, *u.src); return true; }
+TITAN_UOP(CmpRI) { s.flags.sub8(*u.dst, (uint8_t)u.imm); return true; }
+TITAN_UOP(CmpRR) { s.flags.sub8(*u.dst, *u.src); return true; }
+TITAN_UOP(Load) { *u.dst = s.memory[u.imm]; return true; }
+TITAN_UOP(MovRI16) { *u.dst16 = u.imm; return true; }
+TITAN_UOP(MovRR16) { *u.dst16 = *u.src16; return true; }
+TITAN_UOP(AddRI16) { *u.dst16 = s.flags.add16(*u.dst16, u.imm); return true; }
+TITAN_UOP(AddRR16) { *u.dst16 = s.flags.add16(*u.dst16, *u.src16); return true; }
+TITAN_UOP(SubRI16) { *u.dst16 = s.flags.sub16(*u.dst16, u.imm); return true; }
+TITAN_UOP(SubRR16) { *u.dst16 = s.flags.sub16(*u.dst16, *u.src16); return true; }
+TITAN_UOP(CmpRI16) { s.flags.sub16(*u.dst16, u.imm); return true; }
+TITAN_UOP(CmpRR16) { s.flags.sub16(*u.dst16, *u.src16); return true; }
+TITAN_UOP(Load16) { *u.dst16 = s.readWord(u.imm); return true; }
+TITAN_UOP(PrintN) { s.printString(u.imm); return true; }
+TITAN_UOP(Pop) { *u.dst16 = s.pop(); return true; }
+TITAN_UOP(PopF) { s.flags.set(s.pop()); return true; }
+TITAN_UOP(Mul) { s.regs.word(AX) = s.flags.mul8(s.regs.byte(AL), *u.src); return true; }
+TITAN_UOP(Lea) { *u.dst16 = u.imm; return true; }
+
+// Memory writes: leave when the block may have been overwritten
+TITAN_UOP(Store) {
+    s.writeByte(u.imm, *u.src);
+    if (!s.codeStale) return true;
+    s.IP = u.nextIP;
+    return false;
+}
+TITAN_UOP(Store16) {
+    s.writeWord(u.imm, *u.src16);
+    if (!s.codeStale) return true;
+    s.IP = u.nextIP;
+    return false;
+}
+TITAN_UOP(PushImm) {
+    s.push(u.imm);
+    if (!s.codeStale) return true;
+    s.IP = u.nextIP;
+    return false;
+}
+TITAN_UOP(PushReg) {
+    s.push(*u.src16);
+    if (!s.codeStale) return true;
+    s.IP = u.nextIP;
+    return false;
+}
+TITAN_UOP(PushF) {
+    s.push(s.flags.word() | FLAGS_FIXED);
+    if (!s.codeStale) return true;
+    s.IP = u.nextIP;
+    return false;
+}
+
+// Faults
+TITAN_UOP(Div) {
+    s.IP = u.nextIP;
+    s.divide(*u.src);
+    return s.running;
+}
+TITAN_UOP(Invalid) {
+    s.IP = u.nextIP;
+    s.invalidOpcode(u.opcode);
+    return false;
+}
+
+// Block ends
+bool BlockEngine::exit(Simulator& s, const Uop& u) { s.IP = u.nextIP; return false; }
+TITAN_UOP(Int) { s.IP = u.nextIP; s.interrupt((uint8_t)u.imm, false); return false; }
+TITAN_UOP(Call) { s.push(u.nextIP); s.IP = u.imm; return false; }
+TITAN_UOP(Ret) { s.IP = s.pop(); return false; }
+TITAN_UOP(Jmp) { s.IP = u.imm; return false; }
+TITAN_UOP(Jz) { s.IP = s.flags.zf() ? u.imm : u.nextIP; return false; }
+TITAN_UOP(Jnz) { s.IP = s.flags.zf() ? u.nextIP : u.imm; return false; }
+TITAN_UOP(Jcc) { s.IP = s.flags.test(u.opcode & 0x0F) ? u.imm : u.nextIP; return false; }
+
+// Fused pairs
+template <DecodedOp Alu, bool JumpIfZero>
+bool BlockEngine::aluJump(Simulator& s, const Uop& u) {
+    switch (Alu) {
+        case DecodedOp::CmpRI: s.flags.sub8(*u.dst, (uint8_t)u.imm); break;
+        case DecodedOp::CmpRR: s.flags.sub8(*u.dst, *u.src); break;
+        case DecodedOp::AddRI: *u.dst = s.flags.add8(*u.dst, (uint8_t)u.imm); break;
+        case DecodedOp::AddRR: *u.dst = s.flags.add8(*u.dst, *u.src); break;
+        case DecodedOp::SubRI: *u.dst = s.flags.sub8(*u.dst, (uint8_t)u.imm); break;
+        case DecodedOp::SubRR: *u.dst = s.flags.sub8(*u.dst, *u.src); break;
+        case DecodedOp::CmpRI16: s.flags.sub16(*u.dst16, u.imm); break;
+        case DecodedOp::CmpRR16: s.flags.sub16(*u.dst16, *u.src16); break;
+        case DecodedOp::AddRI16: *u.dst16 = s.flags.add16(*u.dst16, u.imm); break;
+        case DecodedOp::AddRR16: *u.dst16 = s.flags.add16(*u.dst16, *u.src16); break;
+        case DecodedOp::SubRI16: *u.dst16 = s.flags.sub16(*u.dst16, u.imm); break;
+        case DecodedOp::SubRR16: *u.dst16 = s.flags.sub16(*u.dst16, *u.src16); break;
+        default: break;
+    }
+    s.IP = s.flags.zf() == JumpIfZero ? u.target : u.nextIP;
+    return false;
+}
+bool BlockEngine::movInt(Simulator& s, const Uop& u) {
+    *u.dst = (uint8_t)u.imm;
+    s.IP = u.nextIP;
+    s.interrupt((uint8_t)u.target, false);
+    return false;
+}
+template <bool FromRegister>
+bool BlockEngine::pushCall(Simulator& s, const Uop& u) {
+    s.push(FromRegister ? *u.src16 : u.imm);
+    s.push(u.nextIP);
+    s.IP = u.target;
+    return false;
+}
+
+#undef TITAN_UOP
+
+BlockEngine::Handler BlockEngine::handlerFor(DecodedOp op) {
+    switch (op) {
+        case DecodedOp::Nop: return exec<DecodedOp::Nop>;
+        case DecodedOp::MovRI: return exec<DecodedOp::MovRI>;
+        case DecodedOp::MovRR: return exec<DecodedOp::MovRR>;
+        case DecodedOp::AddRI: return exec<DecodedOp::AddRI>;
+        case DecodedOp::AddRR: return exec<DecodedOp::AddRR>;
+        case DecodedOp::SubRI: return exec<DecodedOp::SubRI>;
+        case DecodedOp::SubRR: return exec<DecodedOp::SubRR>;
+        case DecodedOp::CmpRI: return exec<DecodedOp::CmpRI>;
+        case DecodedOp::CmpRR: return exec<DecodedOp::CmpRR>;
+        case DecodedOp::Load: return exec<DecodedOp::Load>;
+        case DecodedOp::Store: return exec<DecodedOp::Store>;
+        case DecodedOp::MovRI16: return exec<DecodedOp::MovRI16>;
+        case DecodedOp::MovRR16: return exec<DecodedOp::MovRR16>;
+        case DecodedOp::AddRI16: return exec<DecodedOp::AddRI16>;
+        case DecodedOp::AddRR16: return exec<DecodedOp::AddRR16>;
+        case DecodedOp::SubRI16: return exec<DecodedOp::SubRI16>;
+        case DecodedOp::SubRR16: return exec<DecodedOp::SubRR16>;
+        case DecodedOp::CmpRI16: return exec<DecodedOp::CmpRI16>;
+        case DecodedOp::CmpRR16: return exec<DecodedOp::CmpRR16>;
+        case DecodedOp::Load16: return exec<DecodedOp::Load16>;
+        case DecodedOp::Store16: return exec<DecodedOp::Store16>;
+        case DecodedOp::Int: return exec<DecodedOp::Int>;
+        case DecodedOp::PrintN: return exec<DecodedOp::PrintN>;
+        case DecodedOp::PushImm: return exec<DecodedOp::PushImm>;
+        case DecodedOp::PushReg: return exec<DecodedOp::PushReg>;
+        case DecodedOp::Pop: return exec<DecodedOp::Pop>;
+        case DecodedOp::PushF: return exec<DecodedOp::PushF>;
+        case DecodedOp::PopF: return exec<DecodedOp::PopF>;
+        case DecodedOp::Call: return exec<DecodedOp::Call>;
+        case DecodedOp::Ret: return exec<DecodedOp::Ret>;
+        case DecodedOp::Jmp: return exec<DecodedOp::Jmp>;
+        case DecodedOp::Jz: return exec<DecodedOp::Jz>;
+        case DecodedOp::Jnz: return exec<DecodedOp::Jnz>;
+        case DecodedOp::Jcc: return exec<DecodedOp::Jcc>;
+        case DecodedOp::Mul: return exec<DecodedOp::Mul>;
+        case DecodedOp::Div: return exec<DecodedOp::Div>;
+        case DecodedOp::Lea: return exec<DecodedOp::Lea>;
+        default: return exec<DecodedOp::Invalid>;
+    }
+}
+
+BlockEngine::Handler BlockEngine::fusedJump(DecodedOp op, bool jumpIfZero) {
+#define TITAN_FUSE(alu) \
+    case DecodedOp::alu: return jumpIfZero ? aluJump<DecodedOp::alu, true> : aluJump<DecodedOp::alu, false>;
+    switch (op) {
+        TITAN_FUSE(CmpRI) TITAN_FUSE(CmpRR)
+        TITAN_FUSE(AddRI) TITAN_FUSE(AddRR)
+        TITAN_FUSE(SubRI) TITAN_FUSE(SubRR)
+        TITAN_FUSE(CmpRI16) TITAN_FUSE(CmpRR16)
+        TITAN_FUSE(AddRI16) TITAN_FUSE(AddRR16)
+        TITAN_FUSE(SubRI16) TITAN_FUSE(SubRR16)
+        default: return nullptr;
+    }
+#undef TITAN_FUSE
+}
+
+static bool endsBlock(DecodedOp op) {
+    return op == DecodedOp::Jmp || op == DecodedOp::Jz || op == DecodedOp::Jnz || op == DecodedOp::Jcc ||
+           op == DecodedOp::Call || op == DecodedOp::Ret || op == DecodedOp::Int ||
+           op == DecodedOp::Invalid;
+}
+
+BlockEngine::Block* BlockCache::add(std::unique_ptr<BlockEngine::Block> block) {
+    BlockEngine::Block* b = block.get();
+    byStart[b->start] = b;
+    blocks.push_back(std::move(block));
+    return b;
+}
+
+void BlockCache::clear() {
+    for (const auto& b : blocks) byStart[b->start] = nullptr;
+    blocks.clear();
+}
+
+BlockEngine::Block* BlockEngine::compile(Simulator& s, uint16_t start) {
+    std::unique_ptr<Block> block(new Block());
+    block->start = start;
+    block->count = 0;
+    block->links[0] = block->links[1] = nullptr;
+
+    auto decoded = [&](uint16_t addr) -> const DecodedInstr& {
+        DecodedInstr& d = s.decodeCache[addr];
+        if (d.op == DecodedOp::NotDecoded) s.decode(addr, d);
+        return d;
+    };
+
+    uint16_t addr = start;
+    uint16_t end = start; // Address after the last instruction compiled
+    for (;;) {
+        const DecodedInstr& d = decoded(addr);
+        Uop u{};
+        u.fn = handlerFor(d.op);
+        u.dst = d.dst;
+        u.src = d.src;
+        u.dst16 = d.dst16;
+        u.src16 = d.src16;
+        u.imm = d.imm;
+        u.nextIP = d.nextIP;
+        u.opcode = d.opcode;
+        end = d.nextIP;
+        block->count++;
+
+        // Fuse with a following block end when the pair is common
+        if (!endsBlock(d.op) && d.nextIP > addr) {
+            const DecodedInstr& n = decoded(d.nextIP);
+            Handler fused = nullptr;
+            if (n.op == DecodedOp::Jz || n.op == DecodedOp::Jnz) {
+                fused = fusedJump(d.op, n.op == DecodedOp::Jz);
+            } else if (n.op == DecodedOp::Int && d.op == DecodedOp::MovRI && d.dst == &s.regs.byte(AH)) {
+                fused = movInt;
+            } else if (n.op == DecodedOp::Call && d.op == DecodedOp::PushImm) {
+                fused = pushCall<false>;
+            } else if (n.op == DecodedOp::Call && d.op == DecodedOp::PushReg) {
+                fused = pushCall<true>;
+            }
+            if (fused) {
+                u.fn = fused;
+                u.target = n.imm;
+                u.nextIP = n.nextIP;
+                end = n.nextIP;
+                block->count++;
+                u.retired = block->count;
+                block->uops.push_back(u);
+                break;
+            }
+        }
+
+        u.retired = block->count;
+        block->uops.push_back(u);
+        if (endsBlock(d.op)) break;
+
+        // Invalid opcodes get a block of their own so the fault is exact
+        bool full = block->count >= MAX_BLOCK || d.nextIP < addr;
+        if (full || decoded(d.nextIP).op == DecodedOp::Invalid) {
+            Uop fallThrough{};
+            fallThrough.fn = exit;
+            fallThrough.nextIP = d.nextIP;
+            fallThrough.retired = block->count;
+            block->uops.push_back(fallThrough);
+            break;
+        }
+        addr = d.nextIP;
+    }
+
+    // Stores into any byte of the block must find it
+    s.markCode(start, end);
+    return s.blocks->add(std::move(block));
+}
+
+void BlockEngine::run(Simulator& s, bool& debugMode, int cycleLimit) {
+    // Debugging needs a stop check before every instruction
+    if (debugMode || s.debug.armed) {
+        ThreadedEngine::run(s, debugMode, cycleLimit);
+        return;
+    }
+    if (!s.blocks) s.blocks.reset(new BlockCache());
+    runBlocks(s, cycleLimit);
+}
+
+void BlockEngine::runBlocks(Simulator& s, int cycleLimit) {
+    BlockCache& cache = *s.blocks;
+    Block* b = nullptr;
+    while (s.running) {
+        if (s.codeStale) {
+            s.flushCode();
+            b = nullptr;
+        }
+        Block* next = b ? b->successor(s.IP) : nullptr;
+        if (!next) {
+            next = cache.at(s.IP);
+            if (!next) next = compile(s, s.IP);
+            if (b) b->links[b->links[0] ? 1 : 0] = next;
+        }
+        b = next;
+
+        // Too close to the limit for a whole block: finish one at a time
+        if (cycleLimit - s.cycles < b->count) {
+            bool debugMode = false;
+            ThreadedEngine::run(s, debugMode, cycleLimit);
+            return;
+        }
+        const Uop* u = b->uops.data();
+        while (u->fn(s, *u)) u++;
+        s.cycles += u->retired;
+    }
+}
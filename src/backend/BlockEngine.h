@@ -0,0 +1,90 @@
+#ifndef BLOCKENGINE_H
+#define BLOCKENGINE_H
+
+#include <memory>
+#include <vector>
+#include "Simulator.h"
+
+// Basic-block execution engine. Straight-line code up to the next jump,
+// CALL, RET or INT is compiled once into a list of specialized
+// handlers, and common pairs are fused into one handler: CMP/ADD/SUB
+// followed by JZ/JNZ, MOV AH,imm followed by INT, and PUSH followed by
+// CALL. A block runs without per-instruction fetch, decode, breakpoint or
+// cycle-limit checks, and jumps straight to the successor it last chained.
+//
+// Debug sessions and armed breakpoints or watches fall back to the
+// threaded engine. A store into compiled code flushes every block; the
+// running block is left right after the store.
+struct BlockEngine {
+    struct Uop;
+    // false: leave the block, with IP already at the next instruction
+    typedef bool (*Handler)(Simulator& s, const Uop& u);
+
+    struct Uop {
+        Handler fn;
+        uint8_t* dst;
+        const uint8_t* src;
+        uint16_t* dst16;
+        const uint16_t* src16;
+        uint16_t imm;      // Immediate or address of the first instruction
+        uint16_t target;   // Jump/call target or interrupt number of a fused pair
+        uint16_t nextIP;   // Address after the last instruction covered
+        uint16_t retired;  // Instructions of the block done once this uop completes
+        uint8_t opcode;
+    };
+
+    struct Block {
+        uint16_t start;
+        uint16_t count;      // Instructions in the block
+        std::vector<Uop> uops;
+        Block* links[2];     // Successors chained so far
+
+        Block* successor(uint16_t ip) const {
+            if (links[0] && links[0]->start == ip) return links[0];
+            if (links[1] && links[1]->start == ip) return links[1];
+            return nullptr;
+        }
+    };
+
+    // Executes until the machine stops or reaches cycleLimit
+    static void run(Simulator& s, bool& debugMode, int cycleLimit);
+
+private:
+    static const unsigned MAX_BLOCK = 64; // Instructions per block
+
+    // One decoded op
+    template <DecodedOp Op>
+    static bool exec(Simulator& s, const Uop& u);
+    // Fused pairs
+    template <DecodedOp Alu, bool JumpIfZero>
+    static bool aluJump(Simulator& s, const Uop& u);
+    static bool movInt(Simulator& s, const Uop& u);
+    template <bool FromRegister>
+    static bool pushCall(Simulator& s, const Uop& u);
+    // Falls through to the next block
+    static bool exit(Simulator& s, const Uop& u);
+
+    static Handler handlerFor(DecodedOp op);
+    // Handler for op followed by JZ/JNZ, or nullptr when they do not fuse
+    static Handler fusedJump(DecodedOp op, bool jumpIfZero);
+
+    static Block* compile(Simulator& s, uint16_t start);
+    static void runBlocks(Simulator& s, int cycleLimit);
+};
+
+// Compiled blocks of one simulator, by start address. Blocks live until
+// the next clear(), so chained pointers never dangle.
+class BlockCache {
+private:
+    std::vector<BlockEngine::Block*> byStart;
+    std::vector<std::unique_ptr<BlockEngine::Block>> blocks;
+
+public:
+    BlockCache() : byStart(65536, nullptr) {}
+
+    BlockEngine::Block* at(uint16_t addr) const { return byStart[addr]; }
+    BlockEngine::Block* add(std::unique_ptr<BlockEngine::Block> block);
+    void clear();
+};
+
+#endif
@@ -0,0 +1,113 @@
+#include "Breakpoints.h"
+#include "Lexer.h"
+#include "Flags.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+// FLAG_ bit named by a flag operand, or 0
+static uint16_t flagBit(const std::string& name) {
+    static const struct { const char* upper; const char* lower; uint16_t bit; } FLAGS[] = {
+        { "CF", "cf", FLAG_CF }, { "PF", "pf", FLAG_PF }, { "AF", "af", FLAG_AF },
+        { "ZF", "zf", FLAG_ZF }, { "SF", "sf", FLAG_SF }, { "OF", "of", FLAG_OF }
+    };
+    for (const auto& f : FLAGS) {
+        if (name == f.upper || name == f.lower) return f.bit;
+    }
+    return 0;
+}
+
+bool BreakCondition::parse(const std::string& text, BreakCondition& out) {
+    static const struct { const char* token; Compare compare; } OPS[] = {
+        { "==", Eq }, { "!=", Ne }, { "<=", Le }, { ">=", Ge }, { "<", Lt }, { ">", Gt }
+    };
+
+    size_t opPos = std::string::npos;
+    size_t opLen = 0;
+    for (const auto& op : OPS) {
+        size_t pos = text.find(op.token);
+        if (pos != std::string::npos && (opPos == std::string::npos || pos < opPos)) {
+            opPos = pos;
+            opLen = std::char_traits<char>::length(op.token);
+            out.compare = op.compare;
+        }
+    }
+    if (opPos == std::string::npos || opPos == 0) return false;
+
+    std::string lhs = text.substr(0, opPos);
+    std::string rhs = text.substr(opPos + opLen);
+    if (lhs.size() > 2 && lhs.front() == '[' && lhs.back() == ']') {
+        out.operand = Memory;
+        out.index = (uint16_t)std::strtoul(lhs.c_str() + 1, nullptr, 16);
+    } else if (uint16_t bit = flagBit(lhs)) {
+        out.operand = Flag;
+        out.index = bit;
+    } else {
+        const KeywordInfo* reg = lookupKeyword(lhs);
+        if (!reg || (reg->cls != KeywordClass::Register8 && reg->cls != KeywordClass::Register16)) return false;
+        out.operand = reg->cls == KeywordClass::Register8 ? Byte : Word;
+        out.index = (uint16_t)reg->value;
+    }
+
+    if (rhs.empty() || !(std::isdigit((unsigned char)rhs[0]) || rhs[0] == '-')) return false;
+    out.value = (uint16_t)Lexer::parseNumber(rhs);
+    out.text = text;
+    return true;
+}
+
+bool BreakCondition::test(uint16_t actual) const {
+    switch (compare) {
+        case Eq: return actual == value;
+        case Ne: return actual != value;
+        case Lt: return actual < value;
+        case Le: return actual <= value;
+        case Gt: return actual > value;
+        case Ge: return actual >= value;
+    }
+    return false;
+}
+
+Breakpoints::Breakpoints() : breakBits(WORDS, 0), readBits(WORDS, 0), writeBits(WORDS, 0) {}
+
+void Breakpoints::rebuild() {
+    std::fill(breakBits.begin(), breakBits.end(), 0);
+    std::fill(readBits.begin(), readBits.end(), 0);
+    std::fill(writeBits.begin(), writeBits.end(), 0);
+    for (const Breakpoint& bp : breaks) set(breakBits, bp.address);
+    for (const Watchpoint& wp : watches) {
+        for (uint32_t a = wp.first; a <= wp.last; a++) {
+            if (wp.read) set(readBits, (uint16_t)a);
+            if (wp.write) set(writeBits, (uint16_t)a);
+        }
+    }
+}
+
+void Breakpoints::addBreak(const Breakpoint& bp) {
+    breaks.push_back(bp);
+    set(breakBits, bp.address);
+}
+
+bool Breakpoints::removeBreak(uint16_t addr) {
+    size_t before = breaks.size();
+    breaks.erase(std::remove_if(breaks.begin(), breaks.end(),
+                                [&](const Breakpoint& bp) { return bp.address == addr; }),
+                 breaks.end());
+    if (breaks.size() == before) return false;
+    rebuild();
+    return true;
+}
+
+void Breakpoints::clearBreaks() {
+    breaks.clear();
+    rebuild();
+}
+
+void Breakpoints::addWatch(const Watchpoint& wp) {
+    watches.push_back(wp);
+    rebuild();
+}
+
+void Breakpoints::clearWatches() {
+    watches.clear();
+    rebuild();
+}
@@ -0,0 +1,81 @@
+#ifndef BREAKPOINTS_H
+#define BREAKPOINTS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Optional breakpoint condition "<operand><op><value>", e.g. AL==6,
+// CX!=0, CF==1 or [0800]>=2Ah. Operands are 8/16-bit registers, a status
+// flag (CF PF AF ZF SF OF, read as 0 or 1) or a memory byte at a hex
+// address; values use assembler number syntax.
+struct BreakCondition {
+    enum Operand : uint8_t { Byte, Word, Flag, Memory };
+    enum Compare : uint8_t { Eq, Ne, Lt, Le, Gt, Ge };
+
+    Operand operand;
+    uint16_t index;   // Register ID, FLAG_ bit or memory address
+    Compare compare;
+    uint16_t value;
+    std::string text; // As written, for listing
+
+    static bool parse(const std::string& text, BreakCondition& out);
+    bool test(uint16_t actual) const;
+};
+
+struct Breakpoint {
+    uint16_t address;
+    bool conditional;
+    BreakCondition condition;
+};
+
+// Memory range [first, last] watched for reads and/or writes
+struct Watchpoint {
+    uint16_t first;
+    uint16_t last;
+    bool read;
+    bool write;
+};
+
+// Breakpoints and watchpoints of a debug session. Lookups are one bit test
+// over the 64 KiB address space; the lists are only walked on a hit.
+class Breakpoints {
+private:
+    static const size_t WORDS = 65536 / 64;
+
+    std::vector<uint64_t> breakBits;
+    std::vector<uint64_t> readBits;
+    std::vector<uint64_t> writeBits;
+    std::vector<Breakpoint> breaks;
+    std::vector<Watchpoint> watches;
+
+    static bool test(const std::vector<uint64_t>& bits, uint16_t addr) {
+        return (bits[addr >> 6] >> (addr & 63)) & 1;
+    }
+    static void set(std::vector<uint64_t>& bits, uint16_t addr) {
+        bits[addr >> 6] |= (uint64_t)1 << (addr & 63);
+    }
+    void rebuild();
+
+public:
+    Breakpoints();
+
+    void addBreak(const Breakpoint& bp);
+    bool removeBreak(uint16_t addr);
+    void clearBreaks();
+    void addWatch(const Watchpoint& wp);
+    void clearWatches();
+
+    bool hasBreaks() const { return !breaks.empty(); }
+    bool hasWatches() const { return !watches.empty(); }
+    bool isBreak(uint16_t addr) const { return test(breakBits, addr); }
+    bool watchesRead(uint16_t addr) const { return test(readBits, addr); }
+    bool watchesWrite(uint16_t addr) const { return test(writeBits, addr); }
+    // Bitmap for engines to test directly; nullptr when there are no breakpoints
+    const uint64_t* breakMap() const { return breaks.empty() ? nullptr : breakBits.data(); }
+
+    const std::vector<Breakpoint>& breakList() const { return breaks; }
+    const std::vector<Watchpoint>& watchList() const { return watches; }
+};
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef FLAGS_H
+#define FLAGS_H
+
+#include <cstdint>
+
+// 8086 status flags, at their FLAGS word positions
+enum FlagBit : uint16_t {
+    FLAG_CF = 0x0001,
+    FLAG_PF = 0x0004,
+    FLAG_AF = 0x0010,
+    FLAG_ZF = 0x0040,
+    FLAG_SF = 0x0080,
+    FLAG_OF = 0x0800,
+    FLAG_STATUS = FLAG_CF | FLAG_PF | FLAG_AF | FLAG_ZF | FLAG_SF | FLAG_OF
+};
+
+// Bits PUSHF always sets on an 8086 (bit 1 and the unused top nibble)
+const uint16_t FLAGS_FIXED = 0xF002;
+
+// Conditional jumps other than JZ/JNZ are encoded as JCC_BASE + the 8086
+// condition code (O NO B AE E NE BE A S NS P NP L GE LE G).
+const uint8_t JCC_BASE = 0x60;
+
+// Status flags evaluated lazily. An ALU instruction records only its kind,
+// operands and result; the flags are worked out when a conditional jump,
+// PUSHF or the debugger asks for them. res is zero exactly when ZF is set,
+// so JZ/JNZ never materialize anything.
+struct LazyFlags {
+    enum Kind : uint8_t {
+        Add8,
+        Sub8,  // Also CMP
+        Add16,
+        Sub16,
+        Mul8,  // res = AX. CF = OF = AH != 0, ZF/SF/PF from the product, AF clear
+        Word   // Explicit FLAGS in a (POPF, reset, native code)
+    };
+
+    uint16_t a;
+    uint16_t b;
+    uint16_t res;
+    Kind kind;
+
+    uint8_t add8(uint8_t x, uint8_t y) {
+        kind = Add8; a = x; b = y; res = (uint8_t)(x + y);
+        return (uint8_t)res;
+    }
+    uint8_t sub8(uint8_t x, uint8_t y) {
+        kind = Sub8; a = x; b = y; res = (uint8_t)(x - y);
+        return (uint8_t)res;
+    }
+    uint16_t add16(uint16_t x, uint16_t y) {
+        kind = Add16; a = x; b = y; res = (uint16_t)(x + y);
+        return res;
+    }
+    uint16_t sub16(uint16_t x, uint16_t y) {
+        kind = Sub16; a = x; b = y; res = (uint16_t)(x - y);
+        return res;
+    }
+    uint16_t mul8(uint8_t x, uint8_t y) {
+        kind = Mul8; res = (uint16_t)(x * y);
+        return res;
+    }
+    void set(uint16_t flags) {
+        kind = Word; a = flags & FLAG_STATUS; res = (flags & FLAG_ZF) ? 0 : 1;
+    }
+
+    bool zf() const { return res == 0; }
+
+    // Materialized status flags (FLAG_STATUS bits only)
+    uint16_t word() const {
+        if (kind == Word) return a;
+        uint16_t sign = (kind == Add8 || kind == Sub8) ? 0x80 : 0x8000;
+        uint16_t f = (res == 0 ? FLAG_ZF : 0) | ((res & sign) ? FLAG_SF : 0) | parity(res);
+        switch (kind) {
+            case Add8: case Add16:
+                f |= (res < a ? FLAG_CF : 0) | ((a ^ b ^ res) & FLAG_AF) |
+                     (((a ^ res) & (b ^ res) & sign) ? FLAG_OF : 0);
+                break;
+            case Sub8: case Sub16:
+                f |= (a < b ? FLAG_CF : 0) | ((a ^ b ^ res) & FLAG_AF) |
+                     (((a ^ b) & (a ^ res) & sign) ? FLAG_OF : 0);
+                break;
+            default: // Mul8
+                f |= res > 0xFF ? FLAG_CF | FLAG_OF : 0;
+                break;
+        }
+        return f;
+    }
+
+    // Condition code cc (0..15, see JCC_BASE) holds
+    bool test(uint8_t cc) const {
+        uint16_t f = word();
+        bool sfNeOf = ((f & FLAG_SF) != 0) != ((f & FLAG_OF) != 0);
+        bool r;
+        switch (cc >> 1) {
+            case 0: r = (f & FLAG_OF) != 0; break;
+            case 1: r = (f & FLAG_CF) != 0; break;
+            case 2: r = (f & FLAG_ZF) != 0; break;
+            case 3: r = (f & (FLAG_CF | FLAG_ZF)) != 0; break;
+            case 4: r = (f & FLAG_SF) != 0; break;
+            case 5: r = (f & FLAG_PF) != 0; break;
+            case 6: r = sfNeOf; break;
+            default: r = sfNeOf || (f & FLAG_ZF); break;
+        }
+        return r != (cc & 1);
+    }
+
+private:
+    // PF: even number of set bits in the low byte
+    static uint16_t parity(uint16_t v) {
+        uint8_t x = (uint8_t)v;
+        x ^= x >> 4;
+        x ^= x >> 2;
+        x ^= x >> 1;
+        return (x & 1) ? 0 : FLAG_PF;
+    }
+};
+
+#endif
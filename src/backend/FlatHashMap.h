@@ -0,0 +1,130 @@
+#ifndef FLATHASHMAP_H
+#define FLATHASHMAP_H
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Default key hashes. Integer keys (interned IDs) are used as-is; the table
+// mixes every hash with a Fibonacci multiply before taking the top bits.
+template <typename K>
+struct FlatHash {
+    size_t operator()(const K& k) const { return std::hash<K>()(k); }
+};
+
+template <>
+struct FlatHash<uint32_t> {
+    size_t operator()(uint32_t k) const { return k; }
+};
+
+template <>
+struct FlatHash<std::string_view> {
+    size_t operator()(std::string_view s) const {
+        uint64_t h = 0xCBF29CE484222325ull; // FNV-1a
+        for (char c : s) h = (h ^ (uint8_t)c) * 0x100000001B3ull;
+        return (size_t)h;
+    }
+};
+
+// Open-addressing hash map with linear probing over one flat slot array.
+// Entries are never erased individually, so no tombstones are needed.
+template <typename K, typename V, typename Hash = FlatHash<K>>
+class FlatHashMap {
+private:
+    struct Slot {
+        K key;
+        V value;
+        bool used;
+    };
+
+    std::vector<Slot> slots;
+    size_t count;
+    unsigned shift; // 64 - log2(capacity)
+    Hash hasher;
+
+    size_t indexFor(const K& key) const {
+        return (size_t)(((uint64_t)hasher(key) * 0x9E3779B97F4A7C15ull) >> shift);
+    }
+
+    // Slot holding key, or the empty slot where it would go
+    size_t probe(const K& key) const {
+        size_t mask = slots.size() - 1;
+        size_t i = indexFor(key);
+        while (slots[i].used && !(slots[i].key == key)) i = (i + 1) & mask;
+        return i;
+    }
+
+    void rehash(size_t capacity) {
+        std::vector<Slot> old;
+        old.swap(slots);
+        slots.assign(capacity, Slot{ K(), V(), false });
+        shift = 64;
+        for (size_t c = capacity; c > 1; c >>= 1) shift--;
+        for (Slot& s : old) {
+            if (!s.used) continue;
+            Slot& dst = slots[probe(s.key)];
+            dst.key = std::move(s.key);
+            dst.value = std::move(s.value);
+            dst.used = true;
+        }
+    }
+
+public:
+    explicit FlatHashMap(size_t expected = 0) : count(0), shift(64) {
+        reserve(expected);
+    }
+
+    // Size the table so that n entries fit without rehashing (max load 3/4)
+    void reserve(size_t n) {
+        size_t capacity = 8;
+        while (capacity * 3 < n * 4) capacity <<= 1;
+        if (capacity > slots.size()) rehash(capacity);
+    }
+
+    V* find(const K& key) {
+        if (count == 0) return nullptr;
+        Slot& s = slots[probe(key)];
+        return s.used ? &s.value : nullptr;
+    }
+
+    const V* find(const K& key) const {
+        if (count == 0) return nullptr;
+        const Slot& s = slots[probe(key)];
+        return s.used ? &s.value : nullptr;
+    }
+
+    // Inserts a default-constructed value if key is absent
+    V& operator[](const K& key) {
+        if ((count + 1) * 4 > slots.size() * 3) rehash(slots.size() * 2);
+        Slot& s = slots[probe(key)];
+        if (!s.used) {
+            s.key = key;
+            s.value = V();
+            s.used = true;
+            count++;
+        }
+        return s.value;
+    }
+
+    size_t size() const { return count; }
+
+    void clear() {
+        for (Slot& s : slots) {
+            if (s.used) s = Slot{ K(), V(), false };
+        }
+        count = 0;
+    }
+
+    // Calls f(key, value) for every entry, in slot order
+    template <typename F>
+    void forEach(F f) const {
+        for (const Slot& s : slots) {
+            if (s.used) f(s.key, s.value);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,142 @@
+#include "IODevice.h"
+#include <algorithm>
+
+static const uint64_t FNV_OFFSET = 14695981039346656037ull;
+static const uint64_t FNV_PRIME = 1099511628211ull;
+
+static uint64_t fnv1a(uint64_t hash, const char* data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (uint8_t)data[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+static void put64(std::ostream& os, uint64_t v) {
+    char bytes[8];
+    for (int i = 0; i < 8; i++) bytes[i] = (char)(v >> (8 * i));
+    os.write(bytes, 8);
+}
+
+static uint64_t get64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) v |= (uint64_t)p[i] << (8 * i);
+    return v;
+}
+
+void IODevice::write(const char* data, size_t size) {
+    if (used + size <= BUFFER_SIZE) {
+        std::copy(data, data + size, buffer + used);
+        used += size;
+        return;
+    }
+    // Too large to fit: pass it on in one piece after what is pending
+    drain();
+    if (size < BUFFER_SIZE) {
+        std::copy(data, data + size, buffer);
+        used = size;
+    } else {
+        emit(data, size);
+    }
+}
+
+bool ConsoleDevice::readChar(char& c) {
+    int ch;
+    do {
+        ch = in->get();
+    } while (ch == '\n' || ch == '\r');
+    if (ch == std::char_traits<char>::eof()) return false;
+    c = (char)ch;
+    return true;
+}
+
+void ScriptedDevice::append(const char* data, size_t size) {
+    input.erase(0, inputPos); // Drop what was already read
+    inputPos = 0;
+    input.append(data, size);
+}
+
+bool ScriptedDevice::readChar(char& c) {
+    if (inputPos >= input.size()) return false;
+    c = input[inputPos++];
+    return true;
+}
+
+void ScriptedDevice::emit(const char* data, size_t size) {
+    if (out) out->write(data, (std::streamsize)size);
+    else captured.append(data, size);
+}
+
+RecordingDevice::RecordingDevice(IODevice& inner, std::ostream& log)
+    : inner(inner), log(log), outputLength(0), outputHash(FNV_OFFSET) {
+    const char header[6] = { 'T', 'R', 'E', 'C', (char)(VERSION & 0xFF), (char)(VERSION >> 8) };
+    log.write(header, sizeof(header));
+}
+
+bool RecordingDevice::finish() {
+    log.put((char)0xFF);
+    put64(log, outputLength);
+    put64(log, outputHash);
+    log.flush();
+    return (bool)log;
+}
+
+bool RecordingDevice::readChar(char& c) {
+    if (!inner.readChar(c)) {
+        log.put(0x02);
+        return false;
+    }
+    const char record[2] = { 0x01, c };
+    log.write(record, 2);
+    return true;
+}
+
+void RecordingDevice::emit(const char* data, size_t size) {
+    outputLength += size;
+    outputHash = fnv1a(outputHash, data, size);
+    inner.write(data, size);
+}
+
+ReplayDevice::ReplayDevice(std::ostream* out)
+    : inputPos(0), expectedLength(0), expectedHash(FNV_OFFSET),
+      outputLength(0), outputHash(FNV_OFFSET), out(out) {}
+
+bool ReplayDevice::load(const uint8_t* data, size_t size) {
+    if (size < 6 || data[0] != 'T' || data[1] != 'R' || data[2] != 'E' || data[3] != 'C') return false;
+    if ((data[4] | (data[5] << 8)) != RecordingDevice::VERSION) return false;
+
+    inputs.clear();
+    inputPos = 0;
+    for (size_t p = 6; p < size; ) {
+        switch (data[p]) {
+            case 0x01:
+                if (p + 2 > size) return false;
+                inputs += (char)data[p + 1];
+                p += 2;
+                break;
+            case 0x02:
+                p += 1;
+                break;
+            case 0xFF:
+                if (p + 17 != size) return false;
+                expectedLength = get64(data + p + 1);
+                expectedHash = get64(data + p + 9);
+                return true;
+            default:
+                return false;
+        }
+    }
+    return false; // No summary: the recording was cut short
+}
+
+bool ReplayDevice::readChar(char& c) {
+    if (inputPos >= inputs.size()) return false;
+    c = inputs[inputPos++];
+    return true;
+}
+
+void ReplayDevice::emit(const char* data, size_t size) {
+    outputLength += size;
+    outputHash = fnv1a(outputHash, data, size);
+    if (out) out->write(data, (std::streamsize)size);
+}
@@ -0,0 +1,160 @@
+#ifndef IODEVICE_H
+#define IODEVICE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+// Program I/O of the simulated machine: INT 21h AH=01 reads through
+// readChar(); AH=02/09, PRINTN and error messages write through put() and
+// write(). The debug protocol does not go through the device.
+//
+// Output collects in a fixed buffer and reaches the device's emit() in
+// large writes: when the buffer is full and on flush(). The simulator
+// flushes before reading input, at debug stop points and when a run or
+// step() returns.
+class IODevice {
+public:
+    static const size_t BUFFER_SIZE = 8192;
+
+private:
+    char buffer[BUFFER_SIZE];
+    size_t used = 0;
+
+    void drain() {
+        if (used) emit(buffer, used);
+        used = 0;
+    }
+
+protected:
+    // Buffered output, in order
+    virtual void emit(const char* data, size_t size) = 0;
+    // Push emitted output on, e.g. flush a stream
+    virtual void sync() {}
+
+public:
+    virtual ~IODevice() {}
+    // One input character; false when input is exhausted
+    virtual bool readChar(char& c) = 0;
+
+    void put(char c) {
+        if (used == BUFFER_SIZE) drain();
+        buffer[used++] = c;
+    }
+    void write(const char* data, size_t size);
+    void write(const std::string& text) { write(text.data(), text.size()); }
+    void flush() {
+        drain();
+        sync();
+    }
+};
+
+// Interactive terminal. Keys arrive only after Enter, so line breaks are
+// skipped; every other character, including spaces, is returned.
+class ConsoleDevice : public IODevice {
+private:
+    std::istream* in;
+    std::ostream* out;
+
+public:
+    ConsoleDevice(std::istream& in, std::ostream& out) : in(&in), out(&out) {}
+    void attach(std::istream& input, std::ostream& output) { in = &input; out = &output; }
+
+    bool readChar(char& c) override;
+
+protected:
+    void emit(const char* data, size_t size) override { out->write(data, (std::streamsize)size); }
+    void sync() override { out->flush(); }
+};
+
+// Input from a buffer, returned byte for byte. Output goes to a stream, or
+// is kept in memory when no stream is given.
+class ScriptedDevice : public IODevice {
+private:
+    std::string input;
+    size_t inputPos;
+    std::ostream* out;
+    std::string captured;
+
+public:
+    explicit ScriptedDevice(const std::string& input = "", std::ostream* out = nullptr)
+        : input(input), inputPos(0), out(out) {}
+
+    void append(const char* data, size_t size);
+    // Captured output, flushed first
+    std::string& output() {
+        flush();
+        return captured;
+    }
+
+    bool readChar(char& c) override;
+
+protected:
+    void emit(const char* data, size_t size) override;
+    void sync() override { if (out) out->flush(); }
+};
+
+// Output discarded, no input
+class NullDevice : public IODevice {
+public:
+    bool readChar(char&) override { return false; }
+
+protected:
+    void emit(const char*, size_t) override {}
+};
+
+// Run log: every input character the program consumed, plus the length
+// and FNV-1a hash of everything it wrote. Little-endian:
+//   Header  : "TREC", u16 version
+//   Records : 01 <char>           input character
+//             02                  input exhausted
+//             FF u64 len u64 hash output summary, last record
+// Replaying the inputs reproduces the run; the summary proves it did.
+class RecordingDevice : public IODevice {
+private:
+    IODevice& inner;
+    std::ostream& log;
+    uint64_t outputLength;
+    uint64_t outputHash;
+
+public:
+    static const uint16_t VERSION = 1;
+
+    RecordingDevice(IODevice& inner, std::ostream& log);
+    // Writes the output summary; call once the run is over
+    bool finish();
+
+    bool readChar(char& c) override;
+
+protected:
+    void emit(const char* data, size_t size) override;
+    void sync() override { inner.flush(); }
+};
+
+// Feeds a recorded run's inputs back and checks its output against the
+// summary. Output is also passed on to an optional stream.
+class ReplayDevice : public IODevice {
+private:
+    std::string inputs;
+    size_t inputPos;
+    uint64_t expectedLength;
+    uint64_t expectedHash;
+    uint64_t outputLength;
+    uint64_t outputHash;
+    std::ostream* out;
+
+public:
+    explicit ReplayDevice(std::ostream* out = nullptr);
+    bool load(const uint8_t* data, size_t size);
+    // Output emitted so far equals the recorded output
+    bool matches() const { return outputLength == expectedLength && outputHash == expectedHash; }
+
+    bool readChar(char& c) override;
+
+protected:
+    void emit(const char* data, size_t size) override;
+    void sync() override { if (out) out->flush(); }
+};
+
+#endif
@@ -0,0 +1,476 @@
+#include "JitEngine.h"
+#include "BlockEngine.h"
+#include "ThreadedEngine.h"
+#include <cstring>
+
+#if TITAN_JIT
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#endif
+
+// Host registers by simulated register ID. AL..DH map onto the x86 byte
+// registers (AL CL DL BL AH CH DH BH = 0..7), AX..DX onto EAX..EDX.
+static const uint8_t HOST8[8] = { 0, 4, 3, 7, 1, 5, 2, 6 };
+static const uint8_t HOST16[4] = { 0, 3, 1, 2 };
+
+#define TITAN_CTX(field) ((uint8_t)offsetof(JitContext, field))
+
+namespace {
+
+// Appends x86-64 machine code. Fixed registers in generated code:
+//   RSI memory, RDI JitContext, R8 SP, R9 FLAGS, R10 budget,
+//   R12 codeMap, R13 block table; R11, R14, R15 and RBP are scratch.
+struct Emitter {
+    uint8_t* p;
+
+    void op(std::initializer_list<uint8_t> bytes) { for (uint8_t b : bytes) *p++ = b; }
+    void imm16(uint16_t v) { op({ (uint8_t)v, (uint8_t)(v >> 8) }); }
+    void imm32(uint32_t v) { imm16((uint16_t)v); imm16((uint16_t)(v >> 16)); }
+    static uint8_t modrm(int mod, int reg, int rm) { return (uint8_t)((mod << 6) | ((reg & 7) << 3) | (rm & 7)); }
+
+    // Jump with a rel32 filled in by patch(); returns the field's position
+    uint8_t* jcc(uint8_t cc) { op({ 0x0F, cc }); p += 4; return p - 4; }
+    uint8_t* jmp() { op({ 0xE9 }); p += 4; return p - 4; }
+    static void patch(uint8_t* field, const uint8_t* target) {
+        int32_t rel = (int32_t)(target - (field + 4));
+        std::memcpy(field, &rel, 4);
+    }
+
+    void saveFlags() { op({ 0x9C, 0x41, 0x59 }); }        // pushfq; pop r9
+    void loadFlags() { op({ 0x41, 0x51, 0x9D }); }        // push r9; popfq
+    void testZF() { op({ 0x41, 0xF6, 0xC1, FLAG_ZF }); }  // test r9b, ZF
+    void refund(uint8_t n) { if (n) op({ 0x49, 0x83, 0xC2, n }); } // add r10, n
+};
+
+enum : uint8_t { JZ = 0x84, JNZ = 0x85, JC = 0x82, JL = 0x8C };
+
+// An exit taken from inside a block, emitted after the block's code
+struct ExitStub {
+    uint8_t* field;
+    uint16_t ip;
+    uint8_t refund; // Instructions charged but not executed
+    uint8_t kind;
+    bool dynamic;   // ip is in R14W
+};
+
+// Ops compiled code does not fall through
+bool endsBlock(DecodedOp op) {
+    return op == DecodedOp::Jmp || op == DecodedOp::Jz || op == DecodedOp::Jnz || op == DecodedOp::Jcc ||
+           op == DecodedOp::Call || op == DecodedOp::Ret || op == DecodedOp::Int ||
+           op == DecodedOp::PrintN || op == DecodedOp::Invalid;
+}
+
+// Ops that overwrite every status flag
+bool setsAllFlags(DecodedOp op) {
+    return op == DecodedOp::AddRI || op == DecodedOp::AddRR || op == DecodedOp::SubRI ||
+           op == DecodedOp::SubRR || op == DecodedOp::CmpRI || op == DecodedOp::CmpRR ||
+           op == DecodedOp::AddRI16 || op == DecodedOp::AddRR16 || op == DecodedOp::SubRI16 ||
+           op == DecodedOp::SubRR16 || op == DecodedOp::CmpRI16 || op == DecodedOp::CmpRR16 || op == DecodedOp::Mul;
+}
+
+} // namespace
+
+#if TITAN_JIT
+
+typedef void (*EntryFn)(JitContext* ctx, const uint8_t* code);
+
+JitCache::JitCache() : code(nullptr), used(0), stubsEnd(0), epilogue(nullptr), table(65536, nullptr) {
+#ifdef _WIN32
+    void* mem = VirtualAlloc(nullptr, CODE_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+    if (!mem) return;
+#else
+    void* mem = mmap(nullptr, CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) return;
+#endif
+    code = (uint8_t*)mem;
+
+    // Entry: save callee-saved registers, load the machine state, jump to
+    // the block. Exit: store the state back and return.
+    Emitter e{ code };
+    e.op({ 0x53, 0x55, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57 }); // push rbx rbp r12-r15
+#ifdef _WIN32
+    e.op({ 0x56, 0x57 });                           // push rsi; push rdi
+    e.op({ 0x48, 0x89, 0xCF, 0x48, 0x89, 0xD6 });   // mov rdi, rcx; mov rsi, rdx
+#endif
+    e.op({ 0x49, 0x89, 0xF3 });                     // mov r11, rsi
+    e.op({ 0x48, 0x8B, 0x77, TITAN_CTX(memory) });  // mov rsi, [rdi+memory]
+    e.op({ 0x4C, 0x8B, 0x67, TITAN_CTX(codeMap) }); // mov r12, [rdi+codeMap]
+    e.op({ 0x4C, 0x8B, 0x6F, TITAN_CTX(table) });   // mov r13, [rdi+table]
+    e.op({ 0x4C, 0x8B, 0x57, TITAN_CTX(budget) });  // mov r10, [rdi+budget]
+    for (int r = 0; r < 4; r++) {                   // movzx e?x, word [rdi+regs+2r]
+        e.op({ 0x0F, 0xB7, Emitter::modrm(1, HOST16[r], 7), (uint8_t)(TITAN_CTX(regs) + 2 * r) });
+    }
+    e.op({ 0x44, 0x0F, 0xB7, 0x47, TITAN_CTX(sp) }); // movzx r8d, word [rdi+sp]
+    e.op({ 0x44, 0x0F, 0xB7, 0x4F, TITAN_CTX(flags) }); // movzx r9d, word [rdi+flags]
+    e.op({ 0x41, 0xFF, 0xE3 });                      // jmp r11
+
+    epilogue = e.p;
+    for (int r = 0; r < 4; r++) {                    // mov [rdi+regs+2r], ?x
+        e.op({ 0x66, 0x89, Emitter::modrm(1, HOST16[r], 7), (uint8_t)(TITAN_CTX(regs) + 2 * r) });
+    }
+    e.op({ 0x66, 0x44, 0x89, 0x47, TITAN_CTX(sp) }); // mov [rdi+sp], r8w
+    e.op({ 0x66, 0x44, 0x89, 0x4F, TITAN_CTX(flags) }); // mov [rdi+flags], r9w
+    e.op({ 0x4C, 0x89, 0x57, TITAN_CTX(budget) });   // mov [rdi+budget], r10
+#ifdef _WIN32
+    e.op({ 0x5F, 0x5E });                            // pop rdi; pop rsi
+#endif
+    e.op({ 0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5D, 0x5B }); // pop r15-r12 rbp rbx
+    e.op({ 0xC3 });
+    used = stubsEnd = (size_t)(e.p - code);
+}
+
+JitCache::~JitCache() {
+    if (!code) return;
+#ifdef _WIN32
+    VirtualFree(code, 0, MEM_RELEASE);
+#else
+    munmap(code, CODE_SIZE);
+#endif
+}
+
+void JitCache::enter(JitContext& ctx, const uint8_t* entry) const {
+    reinterpret_cast<EntryFn>(code)(&ctx, entry);
+}
+
+#else
+
+JitCache::JitCache() : code(nullptr), used(0), stubsEnd(0), epilogue(nullptr), table(65536, nullptr) {}
+JitCache::~JitCache() {}
+void JitCache::enter(JitContext&, const uint8_t*) const {}
+
+#endif
+
+void JitCache::clear() {
+    for (uint16_t start : starts) table[start] = nullptr;
+    starts.clear();
+    used = stubsEnd;
+}
+
+// Returns nullptr when the code buffer is full
+const uint8_t* JitEngine::compile(Simulator& s, uint16_t start) {
+    JitCache& cache = *s.jit;
+    if (JitCache::CODE_SIZE - cache.used < JitCache::MAX_BLOCK_CODE) return nullptr;
+
+    // The block's instructions: up to a jump, call, return, an instruction
+    // the interpreter runs, or a wrap past the top of memory
+    std::vector<std::pair<uint16_t, DecodedInstr>> instrs;
+    uint16_t addr = start;
+    for (;;) {
+        // Always from memory: native stores do not invalidate decode entries
+        DecodedInstr& d = s.decodeCache[addr];
+        s.decode(addr, d);
+        instrs.emplace_back(addr, d);
+        if (endsBlock(d.op)) break;
+        if (instrs.size() >= MAX_BLOCK || d.nextIP < addr) break;
+        addr = d.nextIP;
+    }
+    uint8_t count = (uint8_t)instrs.size();
+
+    auto id8 = [&](const uint8_t* r) { return HOST8[r - s.regs.b]; };
+    auto id16 = [&](const uint16_t* r) { return HOST16[r - s.regs.w]; };
+
+    uint8_t* begin = cache.code + cache.used;
+    Emitter e{ begin };
+    std::vector<ExitStub> stubs;
+    auto exitAt = [&](uint8_t* field, uint16_t ip, uint8_t refund, uint8_t kind) {
+        stubs.push_back(ExitStub{ field, ip, refund, kind, false });
+    };
+    // Continues at a known address through the block table
+    auto chain = [&](uint16_t target) {
+        e.op({ 0x4D, 0x8B, 0x9D }); e.imm32((uint32_t)target * 8); // mov r11, [r13+target*8]
+        e.op({ 0x4D, 0x85, 0xDB });                               // test r11, r11
+        exitAt(e.jcc(JZ), target, 0, JitCache::Miss);
+        e.op({ 0x41, 0xFF, 0xE3 });                               // jmp r11
+    };
+    // Leaves when the byte at a static address is code
+    auto codeCheck = [&](uint16_t addr, uint16_t ip, uint8_t refund) {
+        e.op({ 0x41, 0xF6, 0x84, 0x24 }); e.imm32(addr >> 3); // test byte [r12+addr/8], bit
+        e.op({ (uint8_t)(1 << (addr & 7)) });
+        exitAt(e.jcc(JNZ), ip, refund, JitCache::Interpret);
+    };
+    // Runs the instruction on the interpreter
+    auto interpret = [&](uint16_t ip, uint8_t refund) {
+        e.refund(refund);
+        e.op({ 0x66, 0xC7, 0x47, TITAN_CTX(ip) }); e.imm16(ip);
+        e.op({ 0xC6, 0x47, TITAN_CTX(exit), JitCache::Interpret });
+        Emitter::patch(e.jmp(), cache.epilogue);
+    };
+    // SP-2 and SP-1 into R11D and R15D; leaves when either byte is code
+    auto pushCheck = [&](uint16_t ip, uint8_t refund) {
+        e.op({ 0x45, 0x8D, 0x58, 0xFE });       // lea r11d, [r8-2]
+        e.op({ 0x45, 0x0F, 0xB7, 0xDB });       // movzx r11d, r11w
+        e.op({ 0x45, 0x8D, 0x78, 0xFF });       // lea r15d, [r8-1]
+        e.op({ 0x45, 0x0F, 0xB7, 0xFF });       // movzx r15d, r15w
+        e.op({ 0x4D, 0x0F, 0xA3, 0x1C, 0x24 }); // bt [r12], r11
+        exitAt(e.jcc(JC), ip, refund, JitCache::Interpret);
+        e.op({ 0x4D, 0x0F, 0xA3, 0x3C, 0x24 }); // bt [r12], r15
+        exitAt(e.jcc(JC), ip, refund, JitCache::Interpret);
+    };
+    // Stores R14W at SP-2 after pushCheck()
+    auto pushR14 = [&]() {
+        e.op({ 0x46, 0x88, 0x34, 0x1E });       // mov [rsi+r11], r14b
+        e.op({ 0x41, 0xC1, 0xEE, 0x08 });       // shr r14d, 8
+        e.op({ 0x46, 0x88, 0x34, 0x3E });       // mov [rsi+r15], r14b
+        e.op({ 0x45, 0x89, 0xD8 });             // mov r8d, r11d
+    };
+    // Pops into R14D
+    auto popR14 = [&]() {
+        e.op({ 0x46, 0x0F, 0xB6, 0x34, 0x06 }); // movzx r14d, byte [rsi+r8]
+        e.op({ 0x45, 0x8D, 0x78, 0x01 });       // lea r15d, [r8+1]
+        e.op({ 0x45, 0x0F, 0xB7, 0xFF });       // movzx r15d, r15w
+        e.op({ 0x46, 0x0F, 0xB6, 0x3C, 0x3E }); // movzx r15d, byte [rsi+r15]
+        e.op({ 0x41, 0xC1, 0xE7, 0x08 });       // shl r15d, 8
+        e.op({ 0x45, 0x09, 0xFE });             // or r14d, r15d
+        e.op({ 0x41, 0x83, 0xC0, 0x02 });       // add r8d, 2
+        e.op({ 0x45, 0x0F, 0xB7, 0xC0 });       // movzx r8d, r8w
+    };
+
+    // Charge the whole block up front
+    e.op({ 0x49, 0x83, 0xFA, count });          // cmp r10, count
+    exitAt(e.jcc(JL), start, 0, JitCache::Budget);
+    e.op({ 0x49, 0x83, 0xEA, count });          // sub r10, count
+
+    bool flagsLive = false; // Host status flags equal the simulated ones
+    for (uint8_t i = 0; i < count; i++) {
+        uint16_t ip = instrs[i].first;
+        const DecodedInstr& d = instrs[i].second;
+        uint8_t left = (uint8_t)(count - i); // Refund when leaving before this instruction
+        bool setsFlags = false;
+        // Flags of an ADD/SUB/CMP are kept in R9 unless the next instruction replaces them
+        bool keepFlags = i + 1 == count || !setsAllFlags(instrs[i + 1].second.op);
+
+        switch (d.op) {
+            case DecodedOp::Nop: break;
+            case DecodedOp::MovRI: e.op({ (uint8_t)(0xB0 + id8(d.dst)), (uint8_t)d.imm }); break;
+            case DecodedOp::MovRR: e.op({ 0x88, Emitter::modrm(3, id8(d.src), id8(d.dst)) }); break;
+            case DecodedOp::AddRI: case DecodedOp::SubRI: case DecodedOp::CmpRI: {
+                int ext = d.op == DecodedOp::AddRI ? 0 : d.op == DecodedOp::SubRI ? 5 : 7;
+                e.op({ 0x80, Emitter::modrm(3, ext, id8(d.dst)), (uint8_t)d.imm });
+                if (keepFlags) e.saveFlags();
+                setsFlags = true;
+                break;
+            }
+            case DecodedOp::AddRR: case DecodedOp::SubRR: case DecodedOp::CmpRR: {
+                uint8_t opc = d.op == DecodedOp::AddRR ? 0x00 : d.op == DecodedOp::SubRR ? 0x28 : 0x38;
+                e.op({ opc, Emitter::modrm(3, id8(d.src), id8(d.dst)) });
+                if (keepFlags) e.saveFlags();
+                setsFlags = true;
+                break;
+            }
+            case DecodedOp::Load:
+                e.op({ 0x8A, Emitter::modrm(2, id8(d.dst), 6) }); e.imm32(d.imm); // mov r8, [rsi+imm]
+                break;
+            case DecodedOp::Store:
+                codeCheck(d.imm, ip, left);
+                e.op({ 0x88, Emitter::modrm(2, id8(d.src), 6) }); e.imm32(d.imm); // mov [rsi+imm], r8
+                break;
+            case DecodedOp::MovRI16:
+                e.op({ 0x66, (uint8_t)(0xB8 + id16(d.dst16)) }); e.imm16(d.imm);
+                break;
+            case DecodedOp::MovRR16:
+                e.op({ 0x66, 0x89, Emitter::modrm(3, id16(d.src16), id16(d.dst16)) });
+                break;
+            case DecodedOp::AddRI16: case DecodedOp::SubRI16: case DecodedOp::CmpRI16: {
+                int ext = d.op == DecodedOp::AddRI16 ? 0 : d.op == DecodedOp::SubRI16 ? 5 : 7;
+                e.op({ 0x66, 0x81, Emitter::modrm(3, ext, id16(d.dst16)) }); e.imm16(d.imm);
+                if (keepFlags) e.saveFlags();
+                setsFlags = true;
+                break;
+            }
+            case DecodedOp::AddRR16: case DecodedOp::SubRR16: case DecodedOp::CmpRR16: {
+                uint8_t opc = d.op == DecodedOp::AddRR16 ? 0x01 : d.op == DecodedOp::SubRR16 ? 0x29 : 0x39;
+                e.op({ 0x66, opc, Emitter::modrm(3, id16(d.src16), id16(d.dst16)) });
+                if (keepFlags) e.saveFlags();
+                setsFlags = true;
+                break;
+            }
+            // A word at FFFF wraps around memory; the interpreter handles it
+            case DecodedOp::Load16:
+                if (d.imm == 0xFFFF) { interpret(ip, left); break; }
+                e.op({ 0x66, 0x8B, Emitter::modrm(2, id16(d.dst16), 6) }); e.imm32(d.imm); // mov r16, [rsi+imm]
+                break;
+            case DecodedOp::Store16:
+                if (d.imm == 0xFFFF) { interpret(ip, left); break; }
+                codeCheck(d.imm, ip, left);
+                codeCheck((uint16_t)(d.imm + 1), ip, left);
+                e.op({ 0x66, 0x89, Emitter::modrm(2, id16(d.src16), 6) }); e.imm32(d.imm); // mov [rsi+imm], r16
+                break;
+            case DecodedOp::Lea:
+                e.op({ 0x66, (uint8_t)(0xB8 + id16(d.dst16)) }); e.imm16(d.imm);
+                break;
+            case DecodedOp::Mul:
+                // CF = OF from the host MUL; ZF, SF and PF from the product
+                e.op({ 0xF6, Emitter::modrm(3, 4, id8(d.src)) }); // mul r8
+                e.op({ 0x41, 0x0F, 0x92, 0xC3 });                 // setc r11b
+                e.op({ 0x66, 0x85, 0xC0 });                       // test ax, ax
+                e.saveFlags();
+                e.op({ 0x41, 0x81, 0xE1 }); e.imm32((uint16_t)~FLAG_AF); // and r9d, ~AF
+                e.op({ 0x45, 0x0F, 0xB6, 0xDB });                 // movzx r11d, r11b
+                e.op({ 0x45, 0x69, 0xDB }); e.imm32(FLAG_CF | FLAG_OF); // imul r11d, r11d, CF|OF
+                e.op({ 0x45, 0x09, 0xD9 });                       // or r9d, r11d
+                break;
+            case DecodedOp::Div:
+                // AL = AX / src; AH = (AH:AL') % src, with the quotient's low
+                // byte already in AL, as Simulator::divide does
+                e.op({ 0x0F, 0xB6, Emitter::modrm(3, 5, id8(d.src)) }); // movzx ebp, src
+                e.op({ 0x85, 0xED });                                   // test ebp, ebp
+                exitAt(e.jcc(JZ), ip, left, JitCache::Interpret);
+                e.op({ 0x41, 0x89, 0xD6 });             // mov r14d, edx
+                e.op({ 0x41, 0x89, 0xC7 });             // mov r15d, eax
+                e.op({ 0x0F, 0xB7, 0xC0 });             // movzx eax, ax
+                e.op({ 0x31, 0xD2, 0xF7, 0xF5 });       // xor edx, edx; div ebp
+                e.op({ 0x41, 0x89, 0xC3 });             // mov r11d, eax
+                e.op({ 0x41, 0x81, 0xE7 }); e.imm32(0xFF00); // and r15d, 0xFF00
+                e.op({ 0x0F, 0xB6, 0xC0 });             // movzx eax, al
+                e.op({ 0x44, 0x09, 0xF8 });             // or eax, r15d
+                e.op({ 0x31, 0xD2, 0xF7, 0xF5 });       // xor edx, edx; div ebp
+                e.op({ 0x44, 0x89, 0xD8 });             // mov eax, r11d
+                e.op({ 0x88, 0xD4 });                   // mov ah, dl
+                e.op({ 0x44, 0x89, 0xF2 });             // mov edx, r14d
+                break;
+            case DecodedOp::PushImm:
+                pushCheck(ip, left);
+                e.op({ 0x41, 0xBE }); e.imm32(d.imm);  // mov r14d, imm
+                pushR14();
+                break;
+            case DecodedOp::PushReg:
+                pushCheck(ip, left);
+                e.op({ 0x44, 0x0F, 0xB7, Emitter::modrm(3, 6, id16(d.src16)) }); // movzx r14d, r16
+                pushR14();
+                break;
+            case DecodedOp::PushF:
+                pushCheck(ip, left);
+                e.op({ 0x45, 0x89, 0xCE });                              // mov r14d, r9d
+                e.op({ 0x41, 0x81, 0xE6 }); e.imm32(FLAG_STATUS);        // and r14d, STATUS
+                e.op({ 0x41, 0x81, 0xCE }); e.imm32(FLAGS_FIXED);        // or r14d, FIXED
+                pushR14();
+                break;
+            case DecodedOp::PopF:
+                // Only the status bits: a popped TF or DF must not reach the host
+                popR14();
+                e.op({ 0x45, 0x89, 0xF1 });                              // mov r9d, r14d
+                e.op({ 0x41, 0x81, 0xE1 }); e.imm32(FLAG_STATUS);        // and r9d, STATUS
+                break;
+            case DecodedOp::Pop:
+                popR14();
+                if (d.dst16 != &s.sink16) e.op({ 0x66, 0x44, 0x89, Emitter::modrm(3, 6, id16(d.dst16)) }); // mov r16, r14w
+                break;
+            case DecodedOp::Call:
+                pushCheck(ip, left);
+                e.op({ 0x41, 0xBE }); e.imm32(d.nextIP);
+                pushR14();
+                chain(d.imm);
+                break;
+            case DecodedOp::Ret:
+                popR14();
+                e.op({ 0x4F, 0x8B, 0x5C, 0xF5, 0x00 }); // mov r11, [r13+r14*8]
+                e.op({ 0x4D, 0x85, 0xDB });             // test r11, r11
+                stubs.push_back(ExitStub{ e.jcc(JZ), 0, 0, JitCache::Miss, true });
+                e.op({ 0x41, 0xFF, 0xE3 });             // jmp r11
+                break;
+            case DecodedOp::Jmp:
+                chain(d.imm);
+                break;
+            case DecodedOp::Jz: case DecodedOp::Jnz: {
+                if (!flagsLive) e.testZF();
+                // With live flags host ZF is the simulated ZF; after the test it is inverted
+                bool takenOnHostZ = (d.op == DecodedOp::Jz) == flagsLive;
+                uint8_t* notTaken = e.jcc(takenOnHostZ ? JNZ : JZ);
+                chain(d.imm);
+                Emitter::patch(notTaken, e.p);
+                chain(d.nextIP);
+                break;
+            }
+            case DecodedOp::Jcc: {
+                // Host and 8086 condition codes are the same; x ^ 1 is the opposite condition
+                if (!flagsLive) e.loadFlags();
+                uint8_t* notTaken = e.jcc((uint8_t)(0x80 | ((d.opcode & 0x0F) ^ 1)));
+                chain(d.imm);
+                Emitter::patch(notTaken, e.p);
+                chain(d.nextIP);
+                break;
+            }
+            default: // INT, PRINTN, invalid opcodes
+                interpret(ip, left);
+                break;
+        }
+        flagsLive = setsFlags;
+    }
+
+    // Fell off the end of a full block
+    if (!endsBlock(instrs.back().second.op)) chain(instrs.back().second.nextIP);
+
+    for (const ExitStub& x : stubs) {
+        Emitter::patch(x.field, e.p);
+        e.refund(x.refund);
+        if (x.dynamic) e.op({ 0x66, 0x44, 0x89, 0x77, TITAN_CTX(ip) }); // mov [rdi+ip], r14w
+        else { e.op({ 0x66, 0xC7, 0x47, TITAN_CTX(ip) }); e.imm16(x.ip); }
+        e.op({ 0xC6, 0x47, TITAN_CTX(exit), x.kind });
+        Emitter::patch(e.jmp(), cache.epilogue);
+    }
+
+    // Stores into any byte of the block must find it
+    s.markCode(start, instrs.back().second.nextIP);
+    cache.used += (size_t)(e.p - begin);
+    cache.table[start] = begin;
+    cache.starts.push_back(start);
+    return begin;
+}
+
+void JitEngine::run(Simulator& s, bool& debugMode, int cycleLimit) {
+    // Native code checks neither breakpoints nor the checkpoint journal
+    if (debugMode || s.debug.armed || s.journal.tracking()) {
+        ThreadedEngine::run(s, debugMode, cycleLimit);
+        return;
+    }
+    if (!s.jit) s.jit.reset(new JitCache());
+    if (!s.jit->ready() || s.memory.size() < 65536) {
+        BlockEngine::run(s, debugMode, cycleLimit);
+        return;
+    }
+    runNative(s, cycleLimit);
+}
+
+void JitEngine::runNative(Simulator& s, int cycleLimit) {
+    JitCache& cache = *s.jit;
+    JitContext ctx;
+    ctx.memory = s.memory.data();
+    ctx.codeMap = s.codeMap;
+    ctx.table = cache.table.data();
+
+    while (s.running && s.cycles < cycleLimit) {
+        if (s.codeStale) s.flushCode();
+        const uint8_t* entry = cache.at(s.IP);
+        if (!entry) entry = compile(s, s.IP);
+        if (!entry) {
+            s.flushCode(); // Out of code space: start over
+            entry = compile(s, s.IP);
+        }
+
+        for (int r = 0; r < 4; r++) ctx.regs[r] = s.regs.w[r];
+        ctx.sp = s.SP;
+        ctx.flags = s.flags.word();
+        ctx.budget = cycleLimit - s.cycles;
+        int64_t budget = ctx.budget;
+        cache.enter(ctx, entry);
+        for (int r = 0; r < 4; r++) s.regs.w[r] = ctx.regs[r];
+        s.SP = ctx.sp;
+        s.flags.set(ctx.flags);
+        s.IP = ctx.ip;
+        s.cycles += (int)(budget - ctx.budget);
+
+        bool debugMode = false;
+        if (ctx.exit == JitCache::Interpret) {
+            ThreadedEngine::run(s, debugMode, s.cycles + 1);
+        } else if (ctx.exit == JitCache::Budget) {
+            // Too close to the limit for a whole block: finish one at a time
+            ThreadedEngine::run(s, debugMode, cycleLimit);
+            return;
+        }
+    }
+}
+
+#undef TITAN_CTX
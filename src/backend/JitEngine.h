@@ -0,0 +1,86 @@
+#ifndef JITENGINE_H
+#define JITENGINE_H
+
+#include <cstddef>
+#include <vector>
+#include "Simulator.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define TITAN_JIT 1
+#else
+#define TITAN_JIT 0
+#endif
+
+// Native x86-64 execution engine. A block of straight-line code up to the
+// next jump, CALL or RET is compiled into executable memory, with AX..DX
+// pinned in EAX..EDX (so AL..DH are the host's byte registers), SP in R8W
+// and FLAGS in R9. The host computes the same status flags as the 8086 for
+// ADD/SUB/CMP; they are saved to R9 only when the next instruction would
+// not overwrite them anyway. Blocks jump to each other through a
+// per-address table; each one checks and charges the cycle budget on entry.
+//
+// INT, PRINTN, invalid opcodes, division by zero and stores or pushes into
+// compiled code leave native code and run on the interpreter, one
+// instruction at a time. Debug sessions, armed breakpoints or watches and
+// checkpointed runs use the threaded engine; hosts other than x86-64, or
+// ones that refuse executable memory, use the block engine.
+struct JitEngine {
+    // Executes until the machine stops or reaches cycleLimit
+    static void run(Simulator& s, bool& debugMode, int cycleLimit);
+
+private:
+    static const unsigned MAX_BLOCK = 64; // Instructions per block
+
+    static const uint8_t* compile(Simulator& s, uint16_t start);
+    static void runNative(Simulator& s, int cycleLimit);
+};
+
+// Machine state while in native code, at offsets the generated code uses
+struct JitContext {
+    uint8_t* memory;
+    const uint64_t* codeMap;
+    const uint8_t* const* table;
+    int64_t budget;       // Instructions native code may still run
+    uint16_t regs[4];     // AX, BX, CX, DX
+    uint16_t sp;
+    uint16_t ip;          // Where to go on when native code returns
+    uint16_t flags;       // FLAGS; on return, host bits outside FLAG_STATUS too
+    uint8_t exit;         // JitCache::ExitKind
+};
+
+// Executable memory of one simulator: the entry/exit stubs, then compiled
+// blocks, found by start address. Blocks live until the next clear().
+class JitCache {
+public:
+    enum ExitKind : uint8_t {
+        Miss,      // No code at ip yet
+        Interpret, // Run the instruction at ip on the interpreter
+        Budget     // The block at ip needs more cycles than are left
+    };
+
+    JitCache();
+    ~JitCache();
+    JitCache(const JitCache&) = delete;
+    JitCache& operator=(const JitCache&) = delete;
+
+    bool ready() const { return code != nullptr; } // Executable memory was granted
+    const uint8_t* at(uint16_t addr) const { return table[addr]; }
+    void clear();
+
+    // Runs native code from entry until it exits
+    void enter(JitContext& ctx, const uint8_t* entry) const;
+
+private:
+    friend struct JitEngine;
+    static const size_t CODE_SIZE = 4 << 20;
+    static const size_t MAX_BLOCK_CODE = 16 << 10; // Bound on one compiled block
+
+    uint8_t* code;
+    size_t used;
+    size_t stubsEnd;      // Compiled blocks start here
+    const uint8_t* epilogue;
+    std::vector<const uint8_t*> table;
+    std::vector<uint16_t> starts;
+};
+
+#endif
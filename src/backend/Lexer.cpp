@@ -0,0 +1,85 @@
+#include "Lexer.h"
+#include <charconv>
+
+static bool isIdentStart(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == '.' || c == '&' || c == '@' || c == '?' || c == '$';
+}
+
+static bool isIdentChar(char c) {
+    return isIdentStart(c) || (c >= '0' && c <= '9');
+}
+
+void Lexer::tokenize(std::string_view line, std::vector<Token>& out) {
+    size_t i = 0;
+    const size_t n = line.size();
+    while (i < n) {
+        char c = line[i];
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n') { i++; continue; }
+        if (c == ';') break;
+
+        size_t start = i;
+        if (c == '"' || c == '\'') {
+            size_t close = line.find(c, i + 1);
+            i = (close == std::string_view::npos) ? n : close + 1;
+            out.push_back(Token{ TokenKind::String, line.substr(start, i - start), nullptr });
+        } else if (c == ',') {
+            i++;
+            out.push_back(Token{ TokenKind::Comma, line.substr(start, 1), nullptr });
+        } else if (c >= '0' && c <= '9') {
+            while (i < n && isIdentChar(line[i])) i++;
+            out.push_back(Token{ TokenKind::Number, line.substr(start, i - start), nullptr });
+        } else if (c == '-' && i + 1 < n && line[i + 1] >= '0' && line[i + 1] <= '9') {
+            i++;
+            while (i < n && isIdentChar(line[i])) i++;
+            out.push_back(Token{ TokenKind::Number, line.substr(start, i - start), nullptr });
+        } else if (isIdentStart(c)) {
+            while (i < n && isIdentChar(line[i])) i++;
+            std::string_view text = line.substr(start, i - start);
+            if (i < n && line[i] == ':') {
+                i++;
+                out.push_back(Token{ TokenKind::Label, text, nullptr });
+            } else {
+                out.push_back(Token{ TokenKind::Identifier, text, lookupKeyword(text) });
+            }
+        } else {
+            i++;
+            out.push_back(Token{ TokenKind::Other, line.substr(start, 1), nullptr });
+        }
+    }
+}
+
+int Lexer::parseNumber(std::string_view text, int defaultBase) {
+    if (text.empty()) return 0;
+    int base = defaultBase;
+    if (text.back() == 'h' || text.back() == 'H') {
+        text.remove_suffix(1);
+        base = 16;
+    }
+    bool negative = false;
+    if (!text.empty() && text[0] == '-') {
+        negative = true;
+        text.remove_prefix(1);
+    }
+    int value = 0;
+    auto res = std::from_chars(text.data(), text.data() + text.size(), value, base);
+    if (res.ec != std::errc()) return 0;
+    return negative ? -value : value;
+}
+
+int Lexer::valueOf(const Token& t, int defaultBase) {
+    if (t.kind == TokenKind::Number) return parseNumber(t.text, defaultBase);
+    if (t.kind == TokenKind::String) {
+        std::string_view s = stringContents(t);
+        return s.size() == 1 ? (uint8_t)s[0] : 0;
+    }
+    return 0;
+}
+
+std::string_view Lexer::stringContents(const Token& t) {
+    std::string_view s = t.text;
+    if (s.empty()) return s;
+    char q = s[0];
+    s.remove_prefix(1);
+    if (!s.empty() && s.back() == q) s.remove_suffix(1);
+    return s;
+}
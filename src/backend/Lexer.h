@@ -0,0 +1,191 @@
+#ifndef LEXER_H
+#define LEXER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+#include <vector>
+#include "Flags.h"
+
+// Every reserved word the assembler and macro processor recognize
+enum class Keyword : uint8_t {
+    None,
+    // Mnemonics
+    Mov, Add, Sub, Cmp, Mul, Div, Lea,
+    Jmp, Jz, Jnz, Jcc, Call, Ret,
+    Push, Pop, Pushf, Popf, Int, Print, Printn,
+    // Registers
+    AL, AH, BL, BH, CL, CH, DL, DH,
+    AX, BX, CX, DX,
+    // Directives
+    Org, Db, Proc, Endp, End, Include, Macro, Mend
+};
+
+enum class KeywordClass : uint8_t { Mnemonic, Register8, Register16, Directive };
+
+struct KeywordInfo {
+    std::string_view name; // Lowercase spelling
+    Keyword id;
+    KeywordClass cls;
+    uint8_t value;         // Opcode for mnemonics, encoded ID for registers
+};
+
+// Opcode table: mnemonics, registers and directives
+inline constexpr KeywordInfo KEYWORDS[] = {
+    { "mov",     Keyword::Mov,     KeywordClass::Mnemonic,   0x01 },
+    { "add",     Keyword::Add,     KeywordClass::Mnemonic,   0x03 },
+    { "sub",     Keyword::Sub,     KeywordClass::Mnemonic,   0x04 },
+    { "cmp",     Keyword::Cmp,     KeywordClass::Mnemonic,   0x07 },
+    { "mul",     Keyword::Mul,     KeywordClass::Mnemonic,   0x50 },
+    { "div",     Keyword::Div,     KeywordClass::Mnemonic,   0x51 },
+    { "lea",     Keyword::Lea,     KeywordClass::Mnemonic,   0x15 },
+    { "jmp",     Keyword::Jmp,     KeywordClass::Mnemonic,   0x40 },
+    { "jz",      Keyword::Jz,      KeywordClass::Mnemonic,   0x41 },
+    { "jnz",     Keyword::Jnz,     KeywordClass::Mnemonic,   0x42 },
+    { "je",      Keyword::Jz,      KeywordClass::Mnemonic,   0x41 },
+    { "jne",     Keyword::Jnz,     KeywordClass::Mnemonic,   0x42 },
+    { "jo",      Keyword::Jcc,     KeywordClass::Mnemonic,   JCC_BASE + 0x0 },
+    { "jno",     Keyword::Jcc,     KeywordClass::Mnemonic,   JCC_BASE + 0x1 },
+    { "jb",      Keyword::Jcc,     KeywordClass::Mnemonic,   JCC_BASE + 0x2 },
+    { "jc",      Keyword::Jcc,     KeywordClass::Mnemonic,   JCC_BASE + 0x2 },
+    { "jnae",    Keyword::Jcc,     KeywordClass::Mnemonic,   JCC_BASE + 0x2 },
+    { "jae",     Keyword::Jcc,     KeywordClass::Mnemonic,   JCC_BASE + 0x3 },
+    { "jnb",     Keyword::Jcc,     KeywordClass::Mnemonic,   JCC_BASE + 0x3 },
+    { "jnc",     Keyword::Jcc,     KeywordClass::Mnemonic,   JCC_BASE + 0x3 },
+    { "jbe",     Keyword::Jcc,     KeywordClass::Mnemonic,   JCC_BASE + 0x6 },
+    { "jna",     Keyword::Jcc,     KeywordClass::Mnemonic,   JCC_BASE + 0x6 },
+    { "ja",      Keyword::Jcc,     KeywordClass::Mnemonic,   JCC_BASE + 0x7 },
+    { "jnbe",    Keyword::Jcc,     KeywordClass::Mnemonic,   JCC_BASE + 0x7 },
+    { "js",      Keyword::Jcc,     KeywordClass::Mnemonic,   JCC_BASE + 0x8 },
+    { "jns",     Keyword::Jcc,     KeywordClass::Mnemonic,   JCC_BASE + 0x9 },
+    { "jp",      Keyword::Jcc,     KeywordClass::Mnemonic,   JCC_BASE + 0xA },
+    { "jpe",     Keyword::Jcc,     KeywordClass::Mnemonic,   JCC_BASE + 0xA },
+    { "jnp",     Keyword::Jcc,     KeywordClass::Mnemonic,   JCC_BASE + 0xB },
+    { "jpo",     Keyword::Jcc,     KeywordClass::Mnemonic,   JCC_BASE + 0xB },
+    { "jl",      Keyword::Jcc,     KeywordClass::Mnemonic,   JCC_BASE + 0xC },
+    { "jnge",    Keyword::Jcc,     KeywordClass::Mnemonic,   JCC_BASE + 0xC },
+    { "jge",     Keyword::Jcc,     KeywordClass::Mnemonic,   JCC_BASE + 0xD },
+    { "jnl",     Keyword::Jcc,     KeywordClass::Mnemonic,   JCC_BASE + 0xD },
+    { "jle",     Keyword::Jcc,     KeywordClass::Mnemonic,   JCC_BASE + 0xE },
+    { "jng",     Keyword::Jcc,     KeywordClass::Mnemonic,   JCC_BASE + 0xE },
+    { "jg",      Keyword::Jcc,     KeywordClass::Mnemonic,   JCC_BASE + 0xF },
+    { "jnle",    Keyword::Jcc,     KeywordClass::Mnemonic,   JCC_BASE + 0xF },
+    { "call",    Keyword::Call,    KeywordClass::Mnemonic,   0x32 },
+    { "ret",     Keyword::Ret,     KeywordClass::Mnemonic,   0x33 },
+    { "push",    Keyword::Push,    KeywordClass::Mnemonic,   0x30 },
+    { "pop",     Keyword::Pop,     KeywordClass::Mnemonic,   0x31 },
+    { "pushf",   Keyword::Pushf,   KeywordClass::Mnemonic,   0x34 },
+    { "popf",    Keyword::Popf,    KeywordClass::Mnemonic,   0x35 },
+    { "int",     Keyword::Int,     KeywordClass::Mnemonic,   0x10 },
+    { "print",   Keyword::Print,   KeywordClass::Mnemonic,   0x20 },
+    { "printn",  Keyword::Printn,  KeywordClass::Mnemonic,   0x20 },
+    { "al",      Keyword::AL,      KeywordClass::Register8,  0 },
+    { "ah",      Keyword::AH,      KeywordClass::Register8,  1 },
+    { "bl",      Keyword::BL,      KeywordClass::Register8,  2 },
+    { "bh",      Keyword::BH,      KeywordClass::Register8,  3 },
+    { "cl",      Keyword::CL,      KeywordClass::Register8,  4 },
+    { "ch",      Keyword::CH,      KeywordClass::Register8,  5 },
+    { "dl",      Keyword::DL,      KeywordClass::Register8,  6 },
+    { "dh",      Keyword::DH,      KeywordClass::Register8,  7 },
+    { "ax",      Keyword::AX,      KeywordClass::Register16, 0 },
+    { "bx",      Keyword::BX,      KeywordClass::Register16, 2 },
+    { "cx",      Keyword::CX,      KeywordClass::Register16, 4 },
+    { "dx",      Keyword::DX,      KeywordClass::Register16, 6 },
+    { "org",     Keyword::Org,     KeywordClass::Directive,  0 },
+    { "db",      Keyword::Db,      KeywordClass::Directive,  0 },
+    { "proc",    Keyword::Proc,    KeywordClass::Directive,  0 },
+    { "endp",    Keyword::Endp,    KeywordClass::Directive,  0 },
+    { "end",     Keyword::End,     KeywordClass::Directive,  0 },
+    { "include", Keyword::Include, KeywordClass::Directive,  0 },
+    { "macro",   Keyword::Macro,   KeywordClass::Directive,  0 },
+    { "mend",    Keyword::Mend,    KeywordClass::Directive,  0 },
+};
+// Set in the opcode of MOV/ADD/SUB/CMP and the load/store forms of MOV when
+// they operate on a 16-bit register
+inline constexpr uint8_t WORD_OPCODE = 0x80;
+
+inline constexpr size_t KEYWORD_COUNT = sizeof(KEYWORDS) / sizeof(KEYWORDS[0]);
+inline constexpr size_t KEYWORD_MAX_LENGTH = 7;
+
+// FNV-1a over ASCII-case-folded bytes. Keywords are letters only, so folding
+// with 0x20 is exact for them; other tokens are rejected by the final compare.
+constexpr uint32_t keywordHash(std::string_view s, uint32_t seed) {
+    uint32_t h = seed;
+    for (char c : s) h = (h ^ (uint8_t)(c | 0x20)) * 0x01000193u;
+    return h;
+}
+
+// Perfect hash: the seed is searched at compile time so that every keyword
+// lands in its own slot of a 512-entry table.
+struct KeywordHashTable {
+    uint32_t seed;
+    uint8_t slots[512]; // KEYWORDS index + 1, 0 = empty
+};
+
+constexpr KeywordHashTable buildKeywordHashTable() {
+    for (uint32_t seed = 0x811C9DC5u; seed < 0x811C9DC5u + 100000; seed++) {
+        KeywordHashTable t{ seed, {} };
+        bool ok = true;
+        for (size_t i = 0; i < KEYWORD_COUNT && ok; i++) {
+            uint32_t slot = keywordHash(KEYWORDS[i].name, seed) >> 23;
+            if (t.slots[slot]) ok = false;
+            else t.slots[slot] = (uint8_t)(i + 1);
+        }
+        if (ok) return t;
+    }
+    return KeywordHashTable{ 0, {} };
+}
+
+inline constexpr KeywordHashTable KEYWORD_HASH = buildKeywordHashTable();
+static_assert(KEYWORD_HASH.seed != 0, "No collision-free seed for the keyword table");
+
+// Case-insensitive keyword lookup; nullptr if s is not reserved
+inline const KeywordInfo* lookupKeyword(std::string_view s) {
+    if (s.empty() || s.size() > KEYWORD_MAX_LENGTH) return nullptr;
+    uint8_t e = KEYWORD_HASH.slots[keywordHash(s, KEYWORD_HASH.seed) >> 23];
+    if (e == 0) return nullptr;
+    const KeywordInfo& k = KEYWORDS[e - 1];
+    if (k.name.size() != s.size()) return nullptr;
+    for (size_t i = 0; i < s.size(); i++) {
+        if ((char)(s[i] | 0x20) != k.name[i]) return nullptr;
+    }
+    return &k;
+}
+
+enum class TokenKind : uint8_t {
+    Identifier, // Names, keywords, .directives, &params
+    Label,      // Identifier followed by ':' (text excludes the colon)
+    Number,
+    String,     // Single or double quoted; text includes the quotes
+    Comma,
+    Other
+};
+
+// A token is a view into the line it came from; nothing is copied
+struct Token {
+    TokenKind kind;
+    std::string_view text;
+    const KeywordInfo* keyword; // Set for identifiers that are reserved words
+
+    bool is(Keyword k) const { return keyword && keyword->id == k; }
+    bool isRegister() const {
+        return keyword && (keyword->cls == KeywordClass::Register8 || keyword->cls == KeywordClass::Register16);
+    }
+    bool is16() const { return keyword && keyword->cls == KeywordClass::Register16; }
+    bool isSymbol() const { return kind == TokenKind::Identifier && !keyword; }
+};
+
+class Lexer {
+public:
+    // Tokenizes one line up to a ';' comment, appending to out
+    static void tokenize(std::string_view line, std::vector<Token>& out);
+
+    // Decimal or 'h'-suffixed hex. defaultBase applies when there is no suffix.
+    static int parseNumber(std::string_view text, int defaultBase = 10);
+    // Numeric value of an operand: numbers, or a one-character string like 'A'
+    static int valueOf(const Token& t, int defaultBase = 10);
+    // Text between the quotes of a String token
+    static std::string_view stringContents(const Token& t);
+};
+
+#endif
@@ -1,163 +1,287 @@
 #include "MacroProcessor.h"
+#include <filesystem>
+#include <mutex>
+#include <unordered_map>
 
-MacroProcessor::MacroProcessor() {}
+MacroProcessor::MacroProcessor() : depthExceeded(false) {}
 
-std::string MacroProcessor::trim(const std::string& str) {
-    size_t first = str.find_first_not_of(" \t\r\n");
-    if (std::string::npos == first) return "";
-    size_t last = str.find_last_not_of(" \t\r\n");
-    return str.substr(first, (last - first + 1));
-}
-
-std::vector<std::string> MacroProcessor::split(const std::string& str, char delimiter) {
-    std::vector<std::string> tokens;
-    std::string token;
-    std::istringstream tokenStream(str);
-    while (std::getline(tokenStream, token, delimiter)) {
-        tokens.push_back(trim(token));
+void MacroProcessor::compile(MacroDefinition& def) {
+    const std::string& text = def.text;
+    def.pieces.clear();
+    size_t literalStart = 0;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        int match = -1;
+        size_t matchLen = 0;
+        for (size_t i = 0; i < def.parameters.size(); i++) {
+            const std::string& p = def.parameters[i];
+            if (p.size() > matchLen && text.compare(pos, p.size(), p) == 0) {
+                match = (int)i;
+                matchLen = p.size();
+            }
+        }
+        if (match < 0) {
+            pos++;
+            continue;
+        }
+        if (pos > literalStart) {
+            def.pieces.push_back(MacroPiece{ (uint32_t)literalStart, (uint32_t)(pos - literalStart), -1 });
+        }
+        def.pieces.push_back(MacroPiece{ (uint32_t)pos, (uint32_t)matchLen, match });
+        pos += matchLen;
+        literalStart = pos;
+    }
+    if (text.size() > literalStart) {
+        def.pieces.push_back(MacroPiece{ (uint32_t)literalStart, (uint32_t)(text.size() - literalStart), -1 });
     }
-    return tokens;
 }
 
-std::string MacroProcessor::substitute(std::string line, const std::map<std::string, std::string>& argsMap) {
-    std::string result = line;
-    for (auto const& [key, val] : argsMap) {
-        // Find key (e.g., "&A") and replace with val (e.g., "50")
-        size_t pos = 0;
-        while ((pos = result.find(key, pos)) != std::string::npos) {
-            result.replace(pos, key.length(), val);
-            pos += val.length();
-        }
-    }
+std::string MacroProcessor::instantiate(const MacroDefinition& def, const std::vector<std::string_view>& callArgs) {
+    // A parameter without an argument is left as written
+    auto pieceText = [&](const MacroPiece& piece) {
+        if (piece.param >= 0 && (size_t)piece.param < callArgs.size()) return callArgs[piece.param];
+        return std::string_view(def.text).substr(piece.offset, piece.length);
+    };
+
+    size_t total = 0;
+    for (const MacroPiece& piece : def.pieces) total += pieceText(piece).size();
+
+    std::string result;
+    result.reserve(total);
+    for (const MacroPiece& piece : def.pieces) result += pieceText(piece);
     return result;
 }
 
-bool MacroProcessor::expandMacros(const std::string& inputFile, const std::string& outputFile) {
-    std::ifstream inFile(inputFile);
-    std::ofstream outFile(outputFile);
-    
-    if (!inFile.is_open() || !outFile.is_open()) {
-        std::cerr << "MacroProcessor Error: Could not open files." << std::endl;
-        return false;
-    }
-
-    std::string line;
+void MacroProcessor::parse(ParsedSource& parsed, std::string_view source) {
+    const std::string* file = parsed.file();
     bool definingMacro = false;
     std::string currentMacroName = "";
     MacroDefinition currentMacro;
+    int macroLine = 0;
+    int lineNo = 0;
+    std::vector<Token> tokens;
 
-    while (std::getline(inFile, line)) {
-        std::string trimmedLine = trim(line);
-        if (trimmedLine.empty()) {
-            outFile << line << std::endl;
-            continue;
-        }
+    size_t pos = 0;
+    while (pos < source.size()) {
+        size_t eol = source.find('\n', pos);
+        if (eol == std::string_view::npos) eol = source.size();
+        std::string_view line = source.substr(pos, eol - pos);
+        pos = eol + 1;
+        lineNo++;
 
-        // Tokenize by space to check for MACRO keyword
-        std::stringstream ss(trimmedLine);
-        std::string firstToken;
-        ss >> firstToken;
+        tokens.clear();
+        Lexer::tokenize(line, tokens);
 
-        if (firstToken == "MACRO") {
+        if (!tokens.empty() && tokens[0].is(Keyword::Macro)) {
             definingMacro = true;
-            // Format: MACRO Name Arg1 Arg2...
-            ss >> currentMacroName;
+            macroLine = lineNo;
+            // Format: MACRO Name &Arg1, &Arg2...
+            currentMacroName = tokens.size() > 1 ? std::string(tokens[1].text) : "";
             currentMacro = MacroDefinition();
-            
-            std::string arg;
-            while (ss >> arg) {
-                // Support comma-separated args? Usually specific parsing.
-                // Here assume space separated parameters starting with &
-                // e.g. MACRO SUM &A &B
-                if (arg.back() == ',') arg.pop_back();
-                currentMacro.parameters.push_back(arg);
+            for (size_t i = 2; i < tokens.size(); i++) {
+                if (tokens[i].kind != TokenKind::Comma) currentMacro.parameters.push_back(std::string(tokens[i].text));
             }
             continue; // Do not write definition to output
         }
 
-        if (trimmedLine == "MEND") {
+        if (!tokens.empty() && tokens[0].is(Keyword::Mend)) {
             if (definingMacro) {
-                macroTable[currentMacroName] = currentMacro;
+                compile(currentMacro);
+                parsed.items.push_back(ParsedSource::Item{ line, macroLine, 0, 0, (int)parsed.macros.size() });
+                parsed.macros.emplace_back(currentMacroName, std::move(currentMacro));
                 definingMacro = false;
             } else {
-                std::cerr << "Error: MEND without MACRO" << std::endl;
+                parsed.diagnostics.push_back(Diagnostic{ Diagnostic::Error, lineNo, "MEND without MACRO", sourceName(file) });
             }
             continue;
         }
 
         if (definingMacro) {
-            currentMacro.body.push_back(line); // Store original line indentation
+            currentMacro.text += line; // Store original line indentation
+            currentMacro.text += '\n';
             continue;
         }
 
-        // Check if line is a Macro Call
-        // Tokenize line to find Label: Macro Args... or Macro Args...
-        // For simplicity, assume: [Label:] MacroName Arg1, Arg2
-        
-        std::string macroName = firstToken;
-        std::string label = "";
-        std::vector<std::string> callArgs;
-        
-        // Check for Label
-        bool hasLabel = false;
-        if (macroName.back() == ':') {
-            hasLabel = true;
-            label = macroName;
-            ss >> macroName; // Next token should be macro name
+        parsed.items.push_back(ParsedSource::Item{ line, lineNo, parsed.tokens.size(), tokens.size(), -1 });
+        parsed.tokens.insert(parsed.tokens.end(), tokens.begin(), tokens.end());
+    }
+
+    if (definingMacro) {
+        parsed.diagnostics.push_back(Diagnostic{ Diagnostic::Error, lineNo, "MACRO " + currentMacroName + " without MEND", sourceName(file) });
+    }
+}
+
+std::shared_ptr<const ParsedSource> MacroProcessor::loadInclude(const std::string& path, std::string& error) {
+    struct CacheEntry {
+        std::filesystem::file_time_type mtime;
+        std::shared_ptr<const ParsedSource> parsed;
+    };
+    static std::mutex cacheMutex;
+    static std::unordered_map<std::string, CacheEntry> cache;
+
+    std::error_code ec;
+    std::filesystem::file_time_type mtime = std::filesystem::last_write_time(path, ec);
+    if (ec) {
+        error = "Cannot open include file '" + path + "'";
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto it = cache.find(path);
+    if (it != cache.end() && it->second.mtime == mtime) return it->second.parsed;
+
+    std::ifstream inFile(path, std::ios::binary);
+    if (!inFile.is_open()) {
+        error = "Cannot open include file '" + path + "'";
+        return nullptr;
+    }
+    auto parsed = std::make_shared<ParsedSource>();
+    parsed->path = path;
+    parsed->included = true;
+    std::stringstream buffer;
+    buffer << inFile.rdbuf();
+    parsed->text = buffer.str();
+    parse(*parsed, parsed->text);
+
+    cache[path] = CacheEntry{ mtime, parsed };
+    return parsed;
+}
+
+void MacroProcessor::replay(const ParsedSource& parsed, int depth, std::vector<SourceLine>& out, std::vector<Diagnostic>& diagnostics) {
+    diagnostics.insert(diagnostics.end(), parsed.diagnostics.begin(), parsed.diagnostics.end());
+    for (const ParsedSource::Item& item : parsed.items) {
+        if (item.macro >= 0) {
+            const auto& [name, def] = parsed.macros[item.macro];
+            macroTable[names.intern(name)] = &def;
+            continue;
         }
+        if (depth == 0) depthExceeded = false;
+        expandLine(parsed, item.text, item.line, parsed.tokens.data() + item.firstToken, item.tokenCount,
+                   depth, out, diagnostics);
+    }
+}
 
-        if (macroTable.count(macroName)) {
-            // It IS a macro call!
-            
-            // 1. Output the Label if any
-            if (hasLabel) {
-                 // Write label on its own line
-                 outFile << label << std::endl;
-            }
+void MacroProcessor::expandLine(const ParsedSource& from, std::string_view line, int lineNo, const Token* tokens, size_t count,
+                                int depth, std::vector<SourceLine>& out, std::vector<Diagnostic>& diagnostics) {
+    const std::string* file = from.file();
+    if (count == 0) {
+        out.push_back(SourceLine{ line, lineNo, file, {}, 0 });
+        return;
+    }
 
-            // 2. Parse Arguments (rest of the line)
-            // Need to handle "50, 51" or "50 51"
-            std::string restOfLine;
-            std::getline(ss, restOfLine);
-            if (restOfLine.empty() && !ss.eof()) {
-                 // ss might have consumed everything if args were read? No, getline reads rest.
-            }
-            
-            // Clean split by comma or space
-            std::replace(restOfLine.begin(), restOfLine.end(), ',', ' ');
-            std::stringstream argSS(restOfLine);
-            std::string argVal;
-            while (argSS >> argVal) {
-                callArgs.push_back(argVal);
-            }
+    if (tokens[0].is(Keyword::Include)) {
+        if (count < 2) {
+            diagnostics.push_back(Diagnostic{ Diagnostic::Error, lineNo, "INCLUDE requires a file name", sourceName(file) });
+            return;
+        }
+        if (depth >= MAX_DEPTH) {
+            diagnostics.push_back(Diagnostic{ Diagnostic::Error, lineNo, "INCLUDE nested too deeply", sourceName(file) });
+            return;
+        }
+        // The name runs to the last token so paths like lib/io.inc stay whole
+        std::string_view name(tokens[1].text.data(), tokens[count - 1].text.data() + tokens[count - 1].text.size() - tokens[1].text.data());
+        if (count == 2 && tokens[1].kind == TokenKind::String) name = Lexer::stringContents(tokens[1]);
 
-            MacroDefinition& def = macroTable[macroName];
-            
-            if (callArgs.size() != def.parameters.size()) {
-                std::cerr << "Warning: Macro " << macroName << " expects " << def.parameters.size() 
-                          << " args, got " << callArgs.size() << std::endl;
-            }
+        // Relative names are looked up next to the including file first
+        std::filesystem::path target(name);
+        if (target.is_relative() && !from.path.empty()) {
+            std::filesystem::path local = std::filesystem::path(from.path).parent_path() / target;
+            std::error_code ec;
+            if (std::filesystem::exists(local, ec)) target = local;
+        }
 
-            // 3. Map Parameters
-            std::map<std::string, std::string> argsMap;
-            for (size_t i = 0; i < def.parameters.size() && i < callArgs.size(); i++) {
-                argsMap[def.parameters[i]] = callArgs[i];
-            }
+        std::string error;
+        std::shared_ptr<const ParsedSource> included = loadInclude(target.lexically_normal().string(), error);
+        if (!included) {
+            // Sources written for emu8086 include its library by habit, so a
+            // missing file is reported but does not fail the build
+            diagnostics.push_back(Diagnostic{ Diagnostic::Warning, lineNo, error + ", ignored", sourceName(file) });
+            return;
+        }
+        sources.push_back(included);
+        replay(*included, depth + 1, out, diagnostics);
+        return;
+    }
 
-            // 4. Expand Body
-            outFile << "; Begin Macro Expansion: " << macroName << std::endl;
-            for (const std::string& bodyLine : def.body) {
-                outFile << substitute(bodyLine, argsMap) << std::endl;
-            }
-            outFile << "; End Macro Expansion" << std::endl;
+    // Check if line is a Macro Call: [Label:] MacroName Arg1, Arg2
+    size_t nameIdx = (tokens[0].kind == TokenKind::Label) ? 1 : 0;
+    uint32_t nameID = 0;
+    const MacroDefinition* const* found = nullptr;
+    if (nameIdx < count && tokens[nameIdx].isSymbol() && names.find(tokens[nameIdx].text, nameID)) {
+        found = macroTable.find(nameID);
+    }
+
+    if (!found) {
+        // Not a macro, just pass the line through
+        out.push_back(SourceLine{ line, lineNo, file, {}, 0 });
+        return;
+    }
+
+    // It IS a macro call!
+    std::string_view macroName = names.name(nameID);
+    const MacroDefinition& def = **found;
+
+    // 1. Output the Label if any, on its own line
+    if (nameIdx == 1) {
+        out.push_back(SourceLine{ line.substr(0, line.find(':') + 1), lineNo, file, {}, 0 });
+    }
 
-        } else {
-            // Not a macro, just write the line
-            outFile << line << std::endl;
+    if (depth >= MAX_DEPTH) {
+        if (!depthExceeded) {
+            diagnostics.push_back(Diagnostic{ Diagnostic::Error, lineNo,
+                "Macro " + std::string(macroName) + " nested too deeply (recursive macro?)", sourceName(file) });
         }
+        depthExceeded = true;
+        return;
+    }
+
+    // 2. Parse Arguments ("50, 51" or "50 51")
+    std::vector<std::string_view> callArgs;
+    for (size_t i = nameIdx + 1; i < count; i++) {
+        if (tokens[i].kind != TokenKind::Comma) callArgs.push_back(tokens[i].text);
+    }
+
+    if (callArgs.size() != def.parameters.size()) {
+        diagnostics.push_back(Diagnostic{ Diagnostic::Warning, lineNo,
+            "Macro " + std::string(macroName) + " expects " + std::to_string(def.parameters.size())
+            + " args, got " + std::to_string(callArgs.size()), sourceName(file) });
     }
 
-    inFile.close();
-    outFile.close();
+    // 3. Expand Body in one pass (attributed to the call site); the
+    // expanded lines may themselves call macros
+    const std::string& expansion = generated.emplace_back(instantiate(def, callArgs));
+    std::vector<Token>& lineTokens = tokenStack[depth + 1];
+    std::string_view rest = expansion;
+    int bodyLineNo = 0;
+    while (!rest.empty() && !depthExceeded) {
+        size_t nl = rest.find('\n');
+        std::string_view bodyLine = rest.substr(0, nl);
+        rest.remove_prefix(nl + 1);
+        bodyLineNo++;
+
+        lineTokens.clear();
+        Lexer::tokenize(bodyLine, lineTokens);
+        size_t produced = out.size();
+        expandLine(from, bodyLine, lineNo, lineTokens.data(), lineTokens.size(), depth + 1, out, diagnostics);
+        // Lines from nested calls keep their innermost macro
+        for (size_t i = produced; i < out.size(); i++) {
+            if (out[i].macro.empty()) {
+                out[i].macro = macroName;
+                out[i].macroLine = bodyLineNo;
+            }
+        }
+    }
+}
+
+bool MacroProcessor::expand(std::string_view source, std::vector<SourceLine>& out, std::vector<Diagnostic>& diagnostics,
+                            const std::string& sourcePath) {
+    auto parsed = std::make_shared<ParsedSource>();
+    parsed->path = sourcePath;
+    parse(*parsed, source);
+    sources.push_back(parsed);
+
+    tokenStack.resize(MAX_DEPTH + 1);
+    depthExceeded = false;
+    replay(*parsed, 0, out, diagnostics);
     return true;
 }
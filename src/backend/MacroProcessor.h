@@ -8,26 +8,103 @@
 #include <sstream>
 #include <map>
 #include <algorithm>
+#include <deque>
+#include <memory>
+#include <string_view>
+#include "Source.h"
+#include "Lexer.h"
+#include "StringInterner.h"
+#include "FlatHashMap.h"
+
+// One piece of a compiled macro body: either a literal span of
+// MacroDefinition::text or a reference to a parameter slot
+struct MacroPiece {
+    uint32_t offset;
+    uint32_t length;
+    int param; // Slot index into parameters, or -1 for literal text
+};
 
 struct MacroDefinition {
     std::vector<std::string> parameters; // e.g., "&A", "&B"
-    std::vector<std::string> body;       // The lines of code inside
+    std::string text;                    // Body lines, '\n'-terminated, compiled at MEND
+    std::vector<MacroPiece> pieces;      // Body as literal spans and parameter slots
+};
+
+// A source file split into tokenized lines with its MACRO blocks already
+// compiled. Included files are parsed once per process and shared.
+struct ParsedSource {
+    struct Item {
+        std::string_view text;
+        int line;
+        size_t firstToken;
+        size_t tokenCount;
+        int macro; // Index into macros for a MACRO block, otherwise -1
+    };
+
+    std::string path;
+    bool included = false;
+    std::string text;                 // Owned text of an included file
+    std::vector<Token> tokens;        // Views into the source text
+    std::vector<Item> items;
+    std::vector<std::pair<std::string, MacroDefinition>> macros;
+    std::vector<Diagnostic> diagnostics;
+
+    // Name reported in diagnostics; nullptr means the main input
+    const std::string* file() const { return included ? &path : nullptr; }
 };
 
 class MacroProcessor {
 private:
-    std::map<std::string, MacroDefinition> macroTable;
+    // Limit on macro-in-macro and INCLUDE nesting; also stops runaway recursion
+    static const int MAX_DEPTH = 32;
+
+    // Macro names are interned; the table is keyed by name ID and points
+    // into the ParsedSource that defined the macro
+    StringInterner names;
+    FlatHashMap<uint32_t, const MacroDefinition*> macroTable;
+
+    // Sources whose lines and macros are referenced by the output
+    std::vector<std::shared_ptr<const ParsedSource>> sources;
+
+    // Text of expanded macro lines; SourceLine views point into it
+    std::deque<std::string> generated;
+
+    // Token buffers for expanded lines, one per nesting level
+    std::vector<std::vector<Token>> tokenStack;
+
+    // Set once the depth limit is hit so a recursive macro fails fast
+    bool depthExceeded;
+
+    // Splits the body into literal spans and parameter slots. Where several
+    // parameters match at one position the longest wins, so &AB is never
+    // read as &A followed by B.
+    static void compile(MacroDefinition& def);
+
+    // Concatenates the compiled body with callArgs into one buffer
+    static std::string instantiate(const MacroDefinition& def, const std::vector<std::string_view>& callArgs);
+
+    // Tokenizes source into lines and compiles its MACRO blocks
+    static void parse(ParsedSource& parsed, std::string_view source);
+
+    // Returns the parsed include file, reusing the cached copy while the
+    // file's modification time is unchanged. Safe to call from any thread.
+    static std::shared_ptr<const ParsedSource> loadInclude(const std::string& path, std::string& error);
+
+    // Emits the lines of parsed and registers its macros
+    void replay(const ParsedSource& parsed, int depth, std::vector<SourceLine>& out, std::vector<Diagnostic>& diagnostics);
 
-    std::vector<std::string> split(const std::string& str, char delimiter);
-    std::string trim(const std::string& str);
-    
-    // Replace all occurrences of &ARG with value in a line
-    std::string substitute(std::string line, const std::map<std::string, std::string>& argsMap);
+    // Emits one line, expanding macro calls and INCLUDE directives in place
+    void expandLine(const ParsedSource& from, std::string_view line, int lineNo, const Token* tokens, size_t count,
+                    int depth, std::vector<SourceLine>& out, std::vector<Diagnostic>& diagnostics);
 
 public:
     MacroProcessor();
-    // Returns true if success. Writes expanded code to outputFile.
-    bool expandMacros(const std::string& inputFile, const std::string& outputFile);
+    // Splits source into lines and expands macro calls and INCLUDE directives
+    // into out. Each output line keeps the number of the source line it came
+    // from and views either source or this processor's storage, so both must
+    // outlive out. Includes are looked up next to sourcePath first.
+    bool expand(std::string_view source, std::vector<SourceLine>& out, std::vector<Diagnostic>& diagnostics,
+                const std::string& sourcePath = "");
 };
 
 #endif
@@ -0,0 +1,377 @@
+#include "ObjectImage.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char OBJECT_MAGIC[4] = { 'T', 'O', 'B', 'J' };
+
+static void put16(std::vector<uint8_t>& out, uint16_t v) {
+    out.push_back(v & 0xFF);
+    out.push_back((v >> 8) & 0xFF);
+}
+
+static uint16_t get16(const uint8_t* p) { return p[0] | (p[1] << 8); }
+static uint32_t get32(const uint8_t* p) { return get16(p) | ((uint32_t)get16(p + 2) << 16); }
+
+static void putULEB(std::vector<uint8_t>& out, uint32_t v) {
+    while (v >= 0x80) {
+        out.push_back((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((uint8_t)v);
+}
+
+static void putSLEB(std::vector<uint8_t>& out, int32_t v) {
+    putULEB(out, ((uint32_t)v << 1) ^ (uint32_t)(v >> 31)); // Zigzag
+}
+
+static bool getULEB(const uint8_t* data, size_t size, size_t& pos, uint32_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (pos >= size) return false;
+        uint8_t b = data[pos++];
+        v |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+static bool getSLEB(const uint8_t* data, size_t size, size_t& pos, int32_t& v) {
+    uint32_t u;
+    if (!getULEB(data, size, pos, u)) return false;
+    v = (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+    return true;
+}
+
+static void putName(std::vector<uint8_t>& out, const std::string& name) {
+    size_t len = name.size() > 255 ? 255 : name.size();
+    out.push_back((uint8_t)len);
+    out.insert(out.end(), name.begin(), name.begin() + len);
+}
+
+static bool getName(const uint8_t* data, size_t size, size_t& pos, std::string& name) {
+    if (pos + 1 > size || pos + 1 + data[pos] > size) return false;
+    name.assign((const char*)data + pos + 1, data[pos]);
+    pos += 1 + data[pos];
+    return true;
+}
+
+ObjectImage::ObjectImage() {
+    clear();
+}
+
+void ObjectImage::clear() {
+    entry = 0x100;
+    segments.clear();
+    symbols.clear();
+    files.clear();
+    macros.clear();
+    lines.clear();
+    records.clear();
+}
+
+void ObjectImage::emit(uint16_t addr, const uint8_t* bytes, size_t count) {
+    if (count == 0) return;
+    size_t seg = segments.size();
+    for (size_t i = 0; i < segments.size(); i++) {
+        const ObjectSegment& s = segments[i];
+        if (s.base + s.bytes.size() == addr && s.bytes.size() + count <= 0xFFFF) { seg = i; break; }
+    }
+    if (seg == segments.size()) segments.push_back(ObjectSegment{ addr, {} });
+
+    std::vector<uint8_t>& dst = segments[seg].bytes;
+    records.push_back(Record{ addr, (uint16_t)count, (uint32_t)seg, (uint32_t)dst.size() });
+    dst.insert(dst.end(), bytes, bytes + count);
+}
+
+bool ObjectImage::patch16(uint16_t addr, uint16_t value) {
+    for (size_t i = segments.size(); i-- > 0;) {
+        ObjectSegment& s = segments[i];
+        if (addr >= s.base && (size_t)addr + 2 <= s.base + s.bytes.size()) {
+            s.bytes[addr - s.base] = value & 0xFF;
+            s.bytes[addr - s.base + 1] = (value >> 8) & 0xFF;
+            return true;
+        }
+    }
+    return false;
+}
+
+const LineEntry* ObjectImage::lineAt(uint16_t addr) const {
+    auto it = std::lower_bound(lines.begin(), lines.end(), addr,
+                               [](const LineEntry& e, uint16_t a) { return e.address < a; });
+    return it != lines.end() && it->address == addr ? &*it : nullptr;
+}
+
+const ObjectSymbol* ObjectImage::symbolAt(uint16_t addr) const {
+    auto it = std::upper_bound(symbols.begin(), symbols.end(), addr,
+                               [](uint16_t a, const ObjectSymbol& sym) { return a < sym.address; });
+    return it == symbols.begin() ? nullptr : &*(it - 1);
+}
+
+std::string ObjectImage::describe(uint16_t addr, const std::string& mainFile) const {
+    std::string text;
+    if (const LineEntry* line = lineAt(addr)) {
+        const std::string& file = line->file < files.size() ? files[line->file] : std::string();
+        text = (file.empty() ? mainFile : file) + ":" + std::to_string(line->line);
+        if (line->macro && line->macro <= macros.size()) {
+            text += " (" + macros[line->macro - 1] + ":" + std::to_string(line->macroLine) + ")";
+        }
+    }
+    if (const ObjectSymbol* sym = symbolAt(addr)) {
+        if (!text.empty()) text += "  ";
+        text += sym->name;
+        if (sym->address != addr) text += "+" + std::to_string(addr - sym->address);
+    }
+    return text;
+}
+
+void ObjectImage::serialize(std::vector<uint8_t>& out) const {
+    size_t total = HEADER_SIZE;
+    for (const auto& s : segments) total += 4 + s.bytes.size();
+    for (const auto& sym : symbols) total += 3 + sym.name.size();
+    total += lines.size() * 3;
+    out.clear();
+    out.reserve(total);
+
+    out.insert(out.end(), OBJECT_MAGIC, OBJECT_MAGIC + 4);
+    put16(out, VERSION);
+    put16(out, entry);
+    put16(out, (uint16_t)segments.size());
+    put16(out, lines.empty() ? 0 : FLAG_DEBUG_INFO);
+    put16(out, (uint16_t)(symbols.size() & 0xFFFF));
+    put16(out, (uint16_t)(symbols.size() >> 16));
+
+    for (const auto& s : segments) {
+        put16(out, s.base);
+        put16(out, (uint16_t)s.bytes.size());
+        out.insert(out.end(), s.bytes.begin(), s.bytes.end());
+    }
+    for (const auto& sym : symbols) {
+        put16(out, sym.address);
+        putName(out, sym.name);
+    }
+    if (!lines.empty()) serializeDebugInfo(out);
+}
+
+void ObjectImage::serializeDebugInfo(std::vector<uint8_t>& out) const {
+    put16(out, (uint16_t)files.size());
+    for (const std::string& f : files) putName(out, f);
+    put16(out, (uint16_t)macros.size());
+    for (const std::string& m : macros) putName(out, m);
+    put16(out, (uint16_t)(lines.size() & 0xFFFF));
+    put16(out, (uint16_t)(lines.size() >> 16));
+
+    LineEntry prev{ 0, 0, 0, 0, 0 };
+    for (const LineEntry& e : lines) {
+        uint8_t kind = (e.file != prev.file ? 1 : 0) | (e.macro ? 2 : 0);
+        out.push_back(kind);
+        putULEB(out, (uint16_t)(e.address - prev.address));
+        putSLEB(out, (int32_t)(e.line - prev.line));
+        if (kind & 1) putULEB(out, e.file);
+        if (kind & 2) {
+            putULEB(out, e.macro);
+            putULEB(out, e.macroLine);
+        }
+        prev = e;
+    }
+}
+
+bool ObjectImage::parseDebugInfo(const uint8_t* data, size_t size, size_t pos) {
+    if (pos + 2 > size) return false;
+    files.resize(get16(data + pos));
+    pos += 2;
+    for (std::string& f : files) {
+        if (!getName(data, size, pos, f)) return false;
+    }
+    if (pos + 2 > size) return false;
+    macros.resize(get16(data + pos));
+    pos += 2;
+    for (std::string& m : macros) {
+        if (!getName(data, size, pos, m)) return false;
+    }
+    if (pos + 4 > size) return false;
+    uint32_t count = get32(data + pos);
+    pos += 4;
+
+    lines.reserve(count < size ? count : size); // Each line takes at least 3 bytes
+    LineEntry e{ 0, 0, 0, 0, 0 };
+    for (uint32_t i = 0; i < count; i++) {
+        if (pos >= size) return false;
+        uint8_t kind = data[pos++];
+        uint32_t delta, value;
+        int32_t lineDelta;
+        if (!getULEB(data, size, pos, delta) || !getSLEB(data, size, pos, lineDelta)) return false;
+        e.address = (uint16_t)(e.address + delta);
+        e.line = (uint32_t)(e.line + lineDelta);
+        if (kind & 1) {
+            if (!getULEB(data, size, pos, value) || value >= files.size()) return false;
+            e.file = (uint16_t)value;
+        }
+        e.macro = 0;
+        e.macroLine = 0;
+        if (kind & 2) {
+            if (!getULEB(data, size, pos, value) || value > macros.size()) return false;
+            e.macro = (uint16_t)value;
+            if (!getULEB(data, size, pos, value)) return false;
+            e.macroLine = (uint16_t)value;
+        }
+        lines.push_back(e);
+    }
+    return true;
+}
+
+bool ObjectImage::writeBinary(const std::string& path) const {
+    std::vector<uint8_t> buf;
+    serialize(buf);
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) return false;
+    bool ok = std::fwrite(buf.data(), 1, buf.size(), f) == buf.size();
+    return (std::fclose(f) == 0) && ok;
+}
+
+std::string ObjectImage::listing() const {
+    static const char HEX[] = "0123456789abcdef";
+    std::string text = "ADDR CODE\n";
+    text.reserve(records.size() * 16);
+    for (const Record& r : records) {
+        char addr[5] = { HEX[(r.addr >> 12) & 0xF], HEX[(r.addr >> 8) & 0xF], HEX[(r.addr >> 4) & 0xF], HEX[r.addr & 0xF], 0 };
+        text += addr;
+        const uint8_t* bytes = segments[r.segment].bytes.data() + r.offset;
+        for (uint16_t i = 0; i < r.length; i++) {
+            text += ' ';
+            text += HEX[bytes[i] >> 4];
+            text += HEX[bytes[i] & 0xF];
+        }
+        text += '\n';
+    }
+    return text;
+}
+
+bool ObjectImage::writeListing(const std::string& path) const {
+    std::string text = listing();
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) return false;
+    bool ok = std::fwrite(text.data(), 1, text.size(), f) == text.size();
+    return (std::fclose(f) == 0) && ok;
+}
+
+bool ObjectImage::isBinary(const uint8_t* data, size_t size) {
+    return size >= HEADER_SIZE && std::memcmp(data, OBJECT_MAGIC, 4) == 0;
+}
+
+bool ObjectImage::parse(const uint8_t* data, size_t size, ObjectImage& out) {
+    out.clear();
+    if (!isBinary(data, size) || get16(data + 4) != VERSION) return false;
+    out.entry = get16(data + 6);
+    uint16_t segmentCount = get16(data + 8);
+    uint16_t flags = get16(data + 10);
+    uint32_t symbolCount = get32(data + 12);
+
+    size_t pos = HEADER_SIZE;
+    for (uint16_t i = 0; i < segmentCount; i++) {
+        if (pos + 4 > size) return false;
+        uint16_t base = get16(data + pos);
+        uint16_t len = get16(data + pos + 2);
+        pos += 4;
+        if (pos + len > size) return false;
+        out.segments.push_back(ObjectSegment{ base, std::vector<uint8_t>(data + pos, data + pos + len) });
+        pos += len;
+    }
+    for (uint32_t i = 0; i < symbolCount; i++) {
+        if (pos + 3 > size) return false;
+        uint16_t addr = get16(data + pos);
+        uint8_t len = data[pos + 2];
+        pos += 3;
+        if (pos + len > size) return false;
+        out.symbols.push_back(ObjectSymbol{ std::string((const char*)data + pos, len), addr });
+        pos += len;
+    }
+    return !(flags & FLAG_DEBUG_INFO) || out.parseDebugInfo(data, size, pos);
+}
+
+bool ObjectImage::copySegments(const uint8_t* data, size_t size, uint8_t* memory, size_t memorySize, uint16_t& entry) {
+    if (!isBinary(data, size) || get16(data + 4) != VERSION) return false;
+    entry = get16(data + 6);
+    uint16_t segmentCount = get16(data + 8);
+
+    size_t pos = HEADER_SIZE;
+    for (uint16_t i = 0; i < segmentCount; i++) {
+        if (pos + 4 > size) return false;
+        uint16_t base = get16(data + pos);
+        uint16_t len = get16(data + pos + 2);
+        pos += 4;
+        if (pos + len > size || (size_t)base + len > memorySize) return false;
+        std::memcpy(memory + base, data + pos, len);
+        pos += len;
+    }
+    return true;
+}
+
+MappedFile::MappedFile() : ptr(nullptr), length(0) {
+#ifdef _WIN32
+    fileHandle = INVALID_HANDLE_VALUE;
+    mapHandle = nullptr;
+#endif
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+#ifdef _WIN32
+bool MappedFile::open(const std::string& path) {
+    close();
+    fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize)) { close(); return false; }
+    length = (size_t)fileSize.QuadPart;
+    if (length == 0) return true; // Cannot map an empty file
+    mapHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapHandle) { close(); return false; }
+    ptr = (const uint8_t*)MapViewOfFile(mapHandle, FILE_MAP_READ, 0, 0, 0);
+    if (!ptr) { close(); return false; }
+    return true;
+}
+
+void MappedFile::close() {
+    if (ptr) UnmapViewOfFile(ptr);
+    if (mapHandle) CloseHandle(mapHandle);
+    if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+    ptr = nullptr;
+    length = 0;
+    mapHandle = nullptr;
+    fileHandle = INVALID_HANDLE_VALUE;
+}
+#else
+bool MappedFile::open(const std::string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) { ::close(fd); return false; }
+    length = (size_t)st.st_size;
+    if (length > 0) {
+        void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) { ::close(fd); length = 0; return false; }
+        ptr = (const uint8_t*)p;
+    }
+    ::close(fd);
+    return true;
+}
+
+void MappedFile::close() {
+    if (ptr) munmap((void*)ptr, length);
+    ptr = nullptr;
+    length = 0;
+}
+#endif
@@ -0,0 +1,118 @@
+#ifndef OBJECTIMAGE_H
+#define OBJECTIMAGE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Binary object image. All integers are little-endian.
+//   Header  : "TOBJ", u16 version, u16 entry, u16 segmentCount, u16 flags, u32 symbolCount
+//   Segment : u16 base, u16 length, <length> bytes   (code at 0100h, data at 0800h)
+//   Symbol  : u16 address, u8 nameLength, <nameLength> bytes
+// With flags bit 0 (FLAG_DEBUG_INFO) a debug-info section follows the
+// symbols; loaders that only copy segments never read it:
+//   u16 fileCount,  fileCount  x (u8 length, bytes)   file 0 is the main source ("")
+//   u16 macroCount, macroCount x (u8 length, bytes)
+//   u32 lineCount, then per line, deltas against the previous line:
+//     u8 kind (bit 0: file follows, bit 1: macro origin follows)
+//     uleb128 address delta, sleb128 line delta,
+//     [uleb128 file], [uleb128 macro + 1 (0 = none), uleb128 macro line]
+struct ObjectSegment {
+    uint16_t base;
+    std::vector<uint8_t> bytes;
+};
+
+struct ObjectSymbol {
+    std::string name;
+    uint16_t address;
+};
+
+// Source position of the instruction emitted at address
+struct LineEntry {
+    uint16_t address;
+    uint16_t file;      // Index into ObjectImage::files; 0 is the main source ("" when unnamed)
+    uint32_t line;      // Line in file; for macro output, the line of the call
+    uint16_t macro;     // Index into ObjectImage::macros + 1; 0 outside macros
+    uint16_t macroLine; // Line within the macro body, from 1
+};
+
+class ObjectImage {
+public:
+    static const uint16_t VERSION = 1;
+    static const size_t HEADER_SIZE = 16;
+    static const uint16_t FLAG_DEBUG_INFO = 1;
+
+    uint16_t entry;
+    std::vector<ObjectSegment> segments;
+    std::vector<ObjectSymbol> symbols;   // Sorted by address
+    // Debug info: line table sorted by address, and the names it refers to.
+    // Serialized when lines is not empty.
+    std::vector<std::string> files;
+    std::vector<std::string> macros;
+    std::vector<LineEntry> lines;
+
+    ObjectImage();
+    void clear();
+
+    // Place bytes at addr. Emitting at the end of an existing segment extends
+    // it, so interleaved code and data collapse into one segment each.
+    void emit(uint16_t addr, const uint8_t* bytes, size_t count);
+    // Overwrite a little-endian 16-bit field that was already emitted
+    bool patch16(uint16_t addr, uint16_t value);
+
+    // Line of the instruction at addr; nullptr when none starts there
+    const LineEntry* lineAt(uint16_t addr) const;
+    // Nearest symbol at or below addr; nullptr when there is none
+    const ObjectSymbol* symbolAt(uint16_t addr) const;
+    // "file:line (macro:line)  symbol+offset", parts left out when unknown;
+    // lines of an unnamed main source are shown as mainFile:line
+    std::string describe(uint16_t addr, const std::string& mainFile) const;
+
+    void serialize(std::vector<uint8_t>& out) const;
+    bool writeBinary(const std::string& path) const;
+    // Text "ADDR CODE" export, one line per emitted record (GUI machine-code view)
+    std::string listing() const;
+    bool writeListing(const std::string& path) const;
+
+    static bool isBinary(const uint8_t* data, size_t size);
+    static bool parse(const uint8_t* data, size_t size, ObjectImage& out);
+    // Copies every segment straight into memory without building an image
+    static bool copySegments(const uint8_t* data, size_t size, uint8_t* memory, size_t memorySize, uint16_t& entry);
+
+private:
+    void serializeDebugInfo(std::vector<uint8_t>& out) const;
+    bool parseDebugInfo(const uint8_t* data, size_t size, size_t pos);
+
+    struct Record {
+        uint16_t addr;
+        uint16_t length;
+        uint32_t segment;
+        uint32_t offset;
+    };
+    std::vector<Record> records;
+};
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+private:
+    const uint8_t* ptr;
+    size_t length;
+#ifdef _WIN32
+    void* fileHandle;
+    void* mapHandle;
+#endif
+
+public:
+    MappedFile();
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+    const uint8_t* data() const { return ptr; }
+    size_t size() const { return length; }
+};
+
+#endif
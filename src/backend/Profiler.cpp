@@ -0,0 +1,79 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <cstdio>
+
+static const char* const OP_NAMES[] = {
+    "(none)", "nop",
+    "mov r,imm", "mov r,r",
+    "add r,imm", "add r,r", "sub r,imm", "sub r,r",
+    "cmp r,imm", "cmp r,r",
+    "load", "store",
+    "mov r16,imm", "mov r16,r16",
+    "add r16,imm", "add r16,r16", "sub r16,imm", "sub r16,r16",
+    "cmp r16,imm", "cmp r16,r16",
+    "load16", "store16",
+    "int", "printn",
+    "push imm", "push r", "pop", "pushf", "popf",
+    "call", "ret",
+    "jmp", "jz", "jnz", "jcc",
+    "mul", "div",
+    "lea",
+    "invalid"
+};
+static_assert(sizeof(OP_NAMES) / sizeof(OP_NAMES[0]) == (size_t)DecodedOp::Count, "OP_NAMES must follow DecodedOp");
+
+Profiler::Profiler() : counts(65536), taken(65536), kinds(65536) {
+    clear();
+}
+
+void Profiler::clear() {
+    std::fill(counts.begin(), counts.end(), 0);
+    std::fill(taken.begin(), taken.end(), 0);
+    std::fill(kinds.begin(), kinds.end(), DecodedOp::NotDecoded);
+    std::fill(opCounts, opCounts + (int)DecodedOp::Count, 0);
+    total = 0;
+}
+
+void Profiler::report(std::ostream& out, const ObjectImage& image, const std::string& mainFile, size_t limit) const {
+    auto percent = [&](uint64_t n) { return total ? 100.0 * (double)n / (double)total : 0.0; };
+    char line[128];
+
+    std::vector<uint16_t> hot;
+    for (uint32_t a = 0; a < 65536; a++) {
+        if (counts[a]) hot.push_back((uint16_t)a);
+    }
+    std::stable_sort(hot.begin(), hot.end(), [&](uint16_t a, uint16_t b) { return counts[a] > counts[b]; });
+
+    out << "--- Profile: " << total << " instructions ---\n";
+    out << "Hot spots:\n";
+    out << "       Count       %  Addr  Op          Source\n";
+    for (size_t i = 0; i < hot.size() && i < limit; i++) {
+        uint16_t a = hot[i];
+        std::snprintf(line, sizeof(line), "%12llu  %5.1f%%  %04X  %-10s  ",
+                      (unsigned long long)counts[a], percent(counts[a]), a, OP_NAMES[(int)kinds[a]]);
+        out << line << image.describe(a, mainFile) << "\n";
+    }
+
+    out << "Ops:\n";
+    out << "       Count       %  Op\n";
+    std::vector<int> ops;
+    for (int op = 0; op < (int)DecodedOp::Count; op++) {
+        if (opCounts[op]) ops.push_back(op);
+    }
+    std::stable_sort(ops.begin(), ops.end(), [&](int a, int b) { return opCounts[a] > opCounts[b]; });
+    for (int op : ops) {
+        std::snprintf(line, sizeof(line), "%12llu  %5.1f%%  %s\n", (unsigned long long)opCounts[op], percent(opCounts[op]), OP_NAMES[op]);
+        out << line;
+    }
+
+    out << "Conditional jumps:\n";
+    std::snprintf(line, sizeof(line), "  %-4s  %-4s  %10s  %10s  %s\n", "Addr", "Op", "Taken", "Not taken", "Source");
+    out << line;
+    for (uint32_t a = 0; a < 65536; a++) {
+        if (!counts[a] || (kinds[a] != DecodedOp::Jz && kinds[a] != DecodedOp::Jnz && kinds[a] != DecodedOp::Jcc)) continue;
+        std::snprintf(line, sizeof(line), "  %04X  %-4s  %10llu  %10llu  ", a, OP_NAMES[(int)kinds[a]],
+                      (unsigned long long)taken[a], (unsigned long long)(counts[a] - taken[a]));
+        out << line << image.describe((uint16_t)a, mainFile) << "\n";
+    }
+    out << std::flush;
+}
@@ -0,0 +1,45 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Simulator.h"
+#include "ObjectImage.h"
+
+// Execution counts per instruction address and per decoded op, plus taken
+// counts for conditional jumps. Attached with Simulator::setProfiler(); the
+// simulator then runs on the switch engine and calls record() once per
+// instruction.
+// Detached, the only cost is one null test per instruction.
+class Profiler {
+private:
+    std::vector<uint64_t> counts;  // Per start address
+    std::vector<uint64_t> taken;   // Per start address, jumps taken
+    std::vector<DecodedOp> kinds;  // Last op seen per start address
+    uint64_t opCounts[(int)DecodedOp::Count];
+    uint64_t total;
+
+public:
+    Profiler();
+    void clear();
+
+    void record(uint16_t ip, DecodedOp op, bool jumped) {
+        counts[ip]++;
+        kinds[ip] = op;
+        opCounts[(int)op]++;
+        total++;
+        if (jumped) taken[ip]++;
+    }
+
+    uint64_t instructions() const { return total; }
+    uint64_t count(uint16_t ip) const { return counts[ip]; }
+
+    // Text report: the limit hottest addresses, counts per op and every
+    // conditional jump executed. Addresses are named with the image's line table and
+    // symbols; lines of the main source are shown as mainFile:line.
+    void report(std::ostream& out, const ObjectImage& image, const std::string& mainFile, size_t limit = 20) const;
+};
+
+#endif
@@ -1,315 +1,918 @@
 #include "Simulator.h"
+#include "ThreadedEngine.h"
+#include "BlockEngine.h"
+#include "JitEngine.h"
+#include "ObjectImage.h"
+#include "Profiler.h"
+#include "Tracer.h"
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
-Simulator::Simulator(int memorySize) {
+Simulator::Simulator(int memorySize) : console(std::cin, std::cout) {
     memory.resize(memorySize, 0);
-    AX.X = 0; BX.X = 0; CX.X = 0; DX.X = 0;
+    maxCycles = 5000;
+    timeLimit = 0;
+    profiler = nullptr;
+    tracer = nullptr;
+    debugInfo = nullptr;
+    in = &std::cin;
+    out = &std::cout;
+    io = &console;
+    decodeCache.resize(65536);
+    for (auto& w : codeMap) w = 0;
+    reset();
+}
+
+Simulator::~Simulator() {}
+
+void Simulator::reset() {
+    std::fill(memory.begin(), memory.end(), 0);
+    for (auto& w : regs.w) w = 0;
     IP = 0;
+    SP = 0;
     running = false;
-    ZF = false;
+    flags.set(0);
+    cycles = 0;
+    elapsed = 0;
+    termination = Termination::None;
+    faultIP = 0;
+    faultOpcode = 0;
+    sink16 = 0;
+    clearDecoded();
+    clearCheckpoints();
+    inputHistory.clear();
+    inputPos = 0;
 }
 
 uint16_t* Simulator::getRegisterPtr16(const std::string& regName) {
-    if (regName == "AX") return &AX.X;
-    if (regName == "BX") return &BX.X;
-    if (regName == "CX") return &CX.X;
-    if (regName == "DX") return &DX.X;
+    if (regName == "AX") return &regs.word(AX);
+    if (regName == "BX") return &regs.word(BX);
+    if (regName == "CX") return &regs.word(CX);
+    if (regName == "DX") return &regs.word(DX);
     return nullptr;
 }
 
+void Simulator::invalidate(uint16_t addr) {
+    // Instructions are at most 5 bytes, so only entries starting at
+    // addr-4..addr can contain this byte.
+    for (int k = 0; k < 5; k++) {
+        decodeCache[(uint16_t)(addr - k)].op = DecodedOp::NotDecoded;
+    }
+}
+
+void Simulator::clearDecoded() {
+    for (auto& d : decodeCache) d.op = DecodedOp::NotDecoded;
+    codeStale = true;
+}
+
+void Simulator::flushCode() {
+    if (blocks) blocks->clear();
+    if (jit) {
+        jit->clear();
+        // Native code stores into memory without invalidating, so decode
+        // entries of compiled bytes may be stale once they are unmarked
+        for (int i = 0; i < 65536 / 64; i++) {
+            for (int b = 0; codeMap[i] && b < 64; b++) {
+                if ((codeMap[i] >> b) & 1) invalidate((uint16_t)(i * 64 + b));
+            }
+        }
+    }
+    for (auto& w : codeMap) w = 0;
+    codeStale = false;
+}
+
+void Simulator::markCode(uint16_t start, uint16_t end) {
+    for (uint16_t a = start; a != end; a++) codeMap[a >> 6] |= 1ull << (a & 63);
+}
+
+void Simulator::writeByte(uint16_t addr, uint8_t val) {
+    if (journal.tracking()) journal.beforeWrite(addr, memory.data());
+    memory[addr] = val;
+    invalidate(addr);
+    if ((codeMap[addr >> 6] >> (addr & 63)) & 1) codeStale = true;
+    if (tracer) tracer->noteWrite(addr, val);
+    if (debug.watching) noteWrite(addr);
+}
+
+uint16_t Simulator::readWord(uint16_t addr) const {
+    if (addr == 0xFFFF) return memory[addr] | (memory[0] << 8);
+    uint16_t val;
+    std::memcpy(&val, &memory[addr], 2); // Unaligned; the host is little-endian
+    return val;
+}
+
+void Simulator::writeWord(uint16_t addr, uint16_t val) {
+    uint16_t high = (uint16_t)(addr + 1);
+    if (journal.tracking()) {
+        journal.beforeWrite(addr, memory.data());
+        journal.beforeWrite(high, memory.data());
+    }
+    if (addr == 0xFFFF) {
+        memory[addr] = (uint8_t)val;
+        memory[0] = (uint8_t)(val >> 8);
+    } else {
+        std::memcpy(&memory[addr], &val, 2);
+    }
+    invalidate(addr);
+    invalidate(high);
+    if (((codeMap[addr >> 6] >> (addr & 63)) | (codeMap[high >> 6] >> (high & 63))) & 1) codeStale = true;
+    if (tracer) {
+        tracer->noteWrite(addr, (uint8_t)val);
+        tracer->noteWrite(high, (uint8_t)(val >> 8));
+    }
+    if (debug.watching) {
+        noteWrite(addr);
+        noteWrite(high);
+    }
+}
+
+void Simulator::noteWrite(uint16_t addr) {
+    if (addr == debug.watchAddr) debug.watchHit = true;
+    if (debug.points.watchesWrite(addr)) debug.watchpointHit = true;
+}
+
+void Simulator::noteRead(uint16_t addr) {
+    if (debug.points.watchesRead(addr)) debug.watchpointHit = true;
+}
+
+bool Simulator::breakpointHit() {
+    if (!debug.points.isBreak(IP)) return false;
+    for (const Breakpoint& bp : debug.points.breakList()) {
+        if (bp.address != IP) continue;
+        if (!bp.conditional) return true;
+        const BreakCondition& cond = bp.condition;
+        uint16_t actual = 0;
+        switch (cond.operand) {
+            case BreakCondition::Byte: actual = regs.byte((uint8_t)cond.index); break;
+            case BreakCondition::Word: actual = regs.word((uint8_t)cond.index); break;
+            case BreakCondition::Flag: actual = (flags.word() & cond.index) ? 1 : 0; break;
+            case BreakCondition::Memory: actual = memory[cond.index]; break;
+        }
+        if (cond.test(actual)) return true;
+    }
+    return false;
+}
+
 void Simulator::push(uint16_t val) {
     SP -= 2;
-    memory[SP] = val & 0xFF;
-    memory[SP+1] = (val >> 8) & 0xFF;
+    writeByte(SP, val & 0xFF);
+    writeByte(SP + 1, (val >> 8) & 0xFF);
 }
 
 uint16_t Simulator::pop() {
-    uint8_t low = memory[SP];
-    uint8_t high = memory[SP+1];
+    uint16_t val = readWord(SP);
     SP += 2;
-    return (high << 8) | low;
+    return val;
 }
 
 bool Simulator::load(const std::string& objectFile) {
-    std::ifstream file(objectFile);
-    if (!file.is_open()) return false;
+    MappedFile mapped;
+    if (!mapped.open(objectFile)) return false;
 
-    std::string line;
-    std::getline(file, line); // Skip Header
-
-    while (std::getline(file, line)) {
-        if (line.empty()) continue;
-        std::stringstream ss(line);
-        std::string addrToken;
-        ss >> addrToken;
-        if (addrToken.empty()) continue;
-        
-        try {
-            int address = std::stoi(addrToken, nullptr, 16);
-            int byteVal;
-            while (ss >> std::hex >> byteVal) {
-                if (address < memory.size()) {
-                    memory[address++] = (uint8_t)byteVal;
+    if (ObjectImage::isBinary(mapped.data(), mapped.size())) {
+        return loadImage(mapped.data(), mapped.size());
+    } else {
+        // Legacy text format ("ADDR CODE" header, one hex record per line)
+        std::string text((const char*)mapped.data(), mapped.size());
+        std::stringstream file(text);
+        std::string line;
+        std::getline(file, line); // Skip Header
+
+        while (std::getline(file, line)) {
+            if (line.empty()) continue;
+            std::stringstream ss(line);
+            std::string addrToken;
+            ss >> addrToken;
+            if (addrToken.empty()) continue;
+            
+            try {
+                int address = std::stoi(addrToken, nullptr, 16);
+                int byteVal;
+                while (ss >> std::hex >> byteVal) {
+                    if (address < memory.size()) {
+                        memory[address++] = (uint8_t)byteVal;
+                    }
                 }
-            }
-        } catch (...) {}
+            } catch (...) {}
+        }
+        IP = 0x100; 
     }
-    IP = 0x100; 
+    clearDecoded();
+    clearCheckpoints();
     return true;
 }
 
-void Simulator::run(bool debugMode) {
-    running = true;
-    int maxCycles = 5000;
-    int cycles = 0;
-    if (SP == 0) SP = 0xFFFE;
+bool Simulator::loadImage(const uint8_t* data, size_t size) {
+    uint16_t entry = 0x100;
+    if (!ObjectImage::copySegments(data, size, memory.data(), memory.size(), entry)) return false;
+    IP = entry;
+    clearDecoded();
+    clearCheckpoints();
+    return true;
+}
+
+bool Simulator::loadImage(const ObjectImage& image) {
+    for (const ObjectSegment& seg : image.segments) {
+        if (seg.base + seg.bytes.size() > memory.size()) return false;
+        std::copy(seg.bytes.begin(), seg.bytes.end(), memory.begin() + seg.base);
+    }
+    IP = image.entry;
+    clearDecoded();
+    clearCheckpoints();
+    return true;
+}
 
-    if (!debugMode) std::cout << "--- TitanASM Simulation Started (IP=0100) ---" << std::endl;
-    else std::cout << "DEBUG_MODE_START" << std::endl;
-
-    while (running && cycles < maxCycles) {
-        if (debugMode) {
-            std::cout << "DEBUG|" 
-                      << std::hex << std::setw(4) << std::setfill('0') << IP << "|"
-                      << std::setw(4) << AX.X << "|"
-                      << std::setw(4) << BX.X << "|"
-                      << std::setw(4) << CX.X << "|"
-                      << std::setw(4) << DX.X << "|"
-                      << std::setw(4) << SP << "|"
-                      << (ZF?"1":"0") << std::endl;
-            char cmd; std::cin >> cmd;
-            if (cmd == 'q') { running = false; break; }
-            if (cmd == 'r') { debugMode = false; }
+size_t Simulator::checkpoint() {
+    checkpoints.push_back(CpuState{ regs, IP, SP, flags, running, cycles, inputPos });
+    return journal.mark();
+}
+
+bool Simulator::restore(size_t index) {
+    if (index >= checkpoints.size()) return false;
+    journal.rollback(index, memory.data(), [&](unsigned page) {
+        // Restored bytes may hold other code; also drop entries running into the page
+        uint16_t first = (uint16_t)(page << PageJournal::PAGE_BITS);
+        for (int a = -4; a < (int)PageJournal::PAGE_SIZE; a++) {
+            decodeCache[(uint16_t)(first + a)].op = DecodedOp::NotDecoded;
         }
+    });
+    codeStale = true;
+    checkpoints.resize(index + 1);
+    const CpuState& st = checkpoints[index];
+    regs = st.regs;
+    IP = st.IP;
+    SP = st.SP;
+    flags = st.flags;
+    running = st.running;
+    cycles = st.cycles;
+    inputPos = st.inputPos;
+    return true;
+}
 
-        uint8_t opcode = memory[IP++];
-        switch (opcode) {
-            case 0x01: // MOV Reg, Imm
-            {
-                uint8_t regID = memory[IP++];
-                uint16_t val = memory[IP++];
-                val |= (memory[IP++] << 8);
-                uint8_t* r = nullptr;
-                if (regID == 0) r = &AX.L; else if (regID == 1) r = &AX.H;
-                else if (regID == 2) r = &BX.L; else if (regID == 3) r = &BX.H;
-                else if (regID == 4) r = &CX.L; else if (regID == 5) r = &CX.H;
-                else if (regID == 6) r = &DX.L; else if (regID == 7) r = &DX.H;
-                if (r) *r = (uint8_t)val;
-                break;
-            }
-            case 0x02: // MOV Reg, Reg
-            {
-                uint8_t destID = memory[IP++];
-                uint8_t srcID = memory[IP++];
-                uint8_t srcVal = 0;
-                if (srcID == 0) srcVal = AX.L; else if (srcID == 1) srcVal = AX.H;
-                else if (srcID == 2) srcVal = BX.L; else if (srcID == 3) srcVal = BX.H;
-                else if (srcID == 4) srcVal = CX.L; else if (srcID == 5) srcVal = CX.H;
-                else if (srcID == 6) srcVal = DX.L; else if (srcID == 7) srcVal = DX.H;
-                uint8_t* d = nullptr;
-                if (destID == 0) d = &AX.L; else if (destID == 1) d = &AX.H;
-                else if (destID == 2) d = &BX.L; else if (destID == 3) d = &BX.H;
-                else if (destID == 4) d = &CX.L; else if (destID == 5) d = &CX.H;
-                else if (destID == 6) d = &DX.L; else if (destID == 7) d = &DX.H;
-                if (d) *d = srcVal;
-                break;
-            }
-            case 0x03: // ADD
-            case 0x04: // SUB
-            {
-                bool isSub = (opcode == 0x04);
-                uint8_t destID = memory[IP++];
-                uint8_t type = memory[IP++];
-                uint16_t srcVal = memory[IP++];
-                if (type == 1) { // Reg
-                    uint8_t sID = (uint8_t)srcVal;
-                    if (sID == 0) srcVal = AX.L; else if (sID == 1) srcVal = AX.H;
-                    else if (sID == 2) srcVal = BX.L; else if (sID == 3) srcVal = BX.H;
-                    else if (sID == 4) srcVal = CX.L; else if (sID == 5) srcVal = CX.H;
-                    else if (sID == 6) srcVal = DX.L; else if (sID == 7) srcVal = DX.H;
-                }
-                uint8_t* d = nullptr;
-                if (destID == 0) d = &AX.L; else if (destID == 1) d = &AX.H;
-                else if (destID == 2) d = &BX.L; else if (destID == 3) d = &BX.H;
-                else if (destID == 4) d = &CX.L; else if (destID == 5) d = &CX.H;
-                else if (destID == 6) d = &DX.L; else if (destID == 7) d = &DX.H;
-                if (d) { 
-                    if (isSub) *d -= (uint8_t)srcVal; else *d += (uint8_t)srcVal; 
-                    ZF = (*d == 0);
-                }
-                break;
-            }
-            case 0x07: // CMP
-            {
-                uint8_t destID = memory[IP++];
-                uint8_t type = memory[IP++];
-                uint16_t srcVal = memory[IP++];
-                if (type == 1) { // Reg
-                    uint8_t sID = (uint8_t)srcVal;
-                    if (sID == 0) srcVal = AX.L; else if (sID == 1) srcVal = AX.H;
-                    else if (sID == 2) srcVal = BX.L; else if (sID == 3) srcVal = BX.H;
-                }
-                uint8_t destVal = 0;
-                if (destID == 0) destVal = AX.L; else if (destID == 1) destVal = AX.H;
-                else if (destID == 2) destVal = BX.L; else if (destID == 3) destVal = BX.H;
-                ZF = (destVal == (uint8_t)srcVal);
-                break;
-            }
-            case 0x05: // Load
-            {
-                 uint8_t destID = memory[IP++];
-                 uint16_t addr = memory[IP++];
-                 addr |= (memory[IP++] << 8);
-                 uint8_t val = memory[addr];
-                 if (destID == 0) AX.L = val; else if (destID == 1) AX.H = val;
-                 else if (destID == 2) BX.L = val; else if (destID == 3) BX.H = val;
-                 break;
-            }
-            case 0x06: // Store
-            {
-                 uint16_t addr = memory[IP++];
-                 addr |= (memory[IP++] << 8);
-                 uint8_t srcID = memory[IP++];
-                 uint8_t val = 0;
-                 if (srcID == 0) val = AX.L; else if (srcID == 1) val = AX.H;
-                 else if (srcID == 2) val = BX.L; else if (srcID == 3) val = BX.H;
-                 memory[addr] = val;
-                 break;
-            }
-            case 0x10: // INT
-            {
-                uint8_t intNo = memory[IP++];
-                if (intNo == 0x21) {
-                    if (AX.H == 0x4C) running = false;
-                    else if (AX.H == 0x01) {
-                        if (!debugMode) std::cout << "Input Required: ";
-                        char c; std::cin >> c;
-                        std::cout << c << std::endl;
-                        AX.L = c;
-                    }
-                    else if (AX.H == 0x02) std::cout << (char)DX.L;
-                    else if (AX.H == 0x09) { // String Print
-                         uint16_t addr = (DX.X); // Using DS:DX (DS implied same segment)
-                         // Since our memory model is flat for now (small model), DX is offset
-                         while (addr < memory.size() && memory[addr] != '$') {
-                             std::cout << (char)memory[addr++];
-                         }
-                    }
-                }
-                break;
-            }
-            case 0x20: // PRINTN
-            {
-                uint16_t addr = memory[IP++];
-                addr |= (memory[IP++] << 8);
-                while (memory[addr] != 0 && memory[addr] != '$') {
-                    std::cout << (char)memory[addr++];
-                }
-                std::cout << std::endl;
-                break;
-            }
-            case 0x30: // PUSH
-            {
-                uint8_t type = memory[IP++];
-                uint16_t val = memory[IP++];
-                val |= (memory[IP++] << 8);
-                if (type == 1) {
-                    if (val == 0) val = AX.X; else if (val == 1) val = BX.X;
-                    else if (val == 2) val = CX.X; else if (val == 3) val = DX.X;
-                }
-                push(val);
-                break;
-            }
-            case 0x31: // POP
-            {
-                uint8_t type = memory[IP++];
-                uint8_t regID = memory[IP++];
-                IP++; // Padding
-                uint16_t val = pop();
-                if (regID == 0) AX.X = val; else if (regID == 1) BX.X = val;
-                else if (regID == 2) CX.X = val; else if (regID == 3) DX.X = val;
-                break;
-            }
-            case 0x32: // CALL
-            {
-                uint8_t type = memory[IP++];
-                uint16_t addr = memory[IP++];
-                addr |= (memory[IP++] << 8);
-                push(IP); IP = addr;
-                break;
-            }
-            case 0x33: // RET
-            {
-                IP += 3; // Padding
-                IP = pop();
-                break;
-            }
-            case 0x40: // JMP
-            case 0x41: // JZ
-            case 0x42: // JNZ
-            {
-                uint8_t type = memory[IP++];
-                uint16_t addr = memory[IP++];
-                addr |= (memory[IP++] << 8);
-                if (opcode == 0x40) IP = addr;
-                else if (opcode == 0x41 && ZF) IP = addr;
-                else if (opcode == 0x42 && !ZF) IP = addr;
-                break;
+void Simulator::clearCheckpoints() {
+    journal.clear();
+    checkpoints.clear();
+}
+
+void Simulator::setConsole(std::istream& input, std::ostream& output) {
+    in = &input;
+    out = &output;
+    console.attach(input, output);
+    io = &console;
+}
+
+void Simulator::setDevice(IODevice& device) {
+    io = &device;
+}
+
+void Simulator::decode(uint16_t addr, DecodedInstr& d) {
+    auto fetch = [&](int k) -> uint8_t { return memory[(uint16_t)(addr + k)]; };
+    auto word = [&](int k) -> uint16_t { return fetch(k) | (fetch(k + 1) << 8); };
+    // Register IDs are 3 bits and index the register file directly
+    auto reg8 = [&](uint16_t id) -> uint8_t* { return id < 8 ? &regs.byte((uint8_t)id) : nullptr; };
+    auto reg16 = [&](uint16_t id) -> uint16_t* { return id < 8 ? &regs.word((uint8_t)id) : nullptr; };
+
+    d.opcode = fetch(0);
+    d.dst = nullptr; d.src = nullptr;
+    d.dst16 = nullptr; d.src16 = nullptr;
+    d.imm = 0;
+    d.nextIP = (uint16_t)(addr + 1);
+
+    switch (d.opcode) {
+        case 0x01: // MOV Reg, Imm
+            d.dst = reg8(fetch(1));
+            d.imm = word(2);
+            d.op = d.dst ? DecodedOp::MovRI : DecodedOp::Nop;
+            d.nextIP = (uint16_t)(addr + 4);
+            break;
+        case 0x02: // MOV Reg, Reg
+            d.dst = reg8(fetch(1));
+            d.src = reg8(fetch(2));
+            if (!d.dst) d.op = DecodedOp::Nop;
+            else if (d.src) d.op = DecodedOp::MovRR;
+            else d.op = DecodedOp::MovRI; // Unknown source reads as 0
+            d.nextIP = (uint16_t)(addr + 3);
+            break;
+        case 0x03: // ADD
+        case 0x04: // SUB
+        {
+            bool isSub = (d.opcode == 0x04);
+            d.dst = reg8(fetch(1));
+            uint8_t type = fetch(2);
+            d.imm = fetch(3);
+            if (type == 1) d.src = reg8(d.imm); // Unknown source keeps its raw ID
+            if (!d.dst) d.op = DecodedOp::Nop;
+            else if (d.src) d.op = isSub ? DecodedOp::SubRR : DecodedOp::AddRR;
+            else d.op = isSub ? DecodedOp::SubRI : DecodedOp::AddRI;
+            d.nextIP = (uint16_t)(addr + 4);
+            break;
+        }
+        case 0x07: // CMP
+        {
+            d.dst = reg8(fetch(1));
+            uint8_t type = fetch(2);
+            d.imm = fetch(3);
+            if (type == 1) d.src = reg8(d.imm); // Unknown source keeps its raw ID
+            if (!d.dst) d.op = DecodedOp::Nop;
+            else d.op = d.src ? DecodedOp::CmpRR : DecodedOp::CmpRI;
+            d.nextIP = (uint16_t)(addr + 4);
+            break;
+        }
+        case 0x05: // Load
+            d.dst = reg8(fetch(1));
+            d.imm = word(2);
+            d.op = d.dst ? DecodedOp::Load : DecodedOp::Nop;
+            d.nextIP = (uint16_t)(addr + 4);
+            break;
+        case 0x06: // Store
+            d.imm = word(1);
+            d.src = reg8(fetch(3));
+            d.op = d.src ? DecodedOp::Store : DecodedOp::Nop;
+            d.nextIP = (uint16_t)(addr + 4);
+            break;
+        case 0x81: // MOV Reg16, Imm16
+            d.dst16 = reg16(fetch(1));
+            d.imm = word(2);
+            d.op = d.dst16 ? DecodedOp::MovRI16 : DecodedOp::Nop;
+            d.nextIP = (uint16_t)(addr + 4);
+            break;
+        case 0x82: // MOV Reg16, Reg16
+            d.dst16 = reg16(fetch(1));
+            d.src16 = reg16(fetch(2));
+            if (!d.dst16) d.op = DecodedOp::Nop;
+            else if (d.src16) d.op = DecodedOp::MovRR16;
+            else d.op = DecodedOp::MovRI16; // Unknown source reads as 0
+            d.nextIP = (uint16_t)(addr + 3);
+            break;
+        case 0x83: // ADD r16
+        case 0x84: // SUB r16
+        case 0x87: // CMP r16
+        {
+            d.dst16 = reg16(fetch(1));
+            uint8_t type = fetch(2);
+            d.imm = word(3);
+            if (type == 1) d.src16 = reg16(d.imm); // Unknown source keeps its raw ID
+            if (!d.dst16) d.op = DecodedOp::Nop;
+            else if (d.opcode == 0x83) d.op = d.src16 ? DecodedOp::AddRR16 : DecodedOp::AddRI16;
+            else if (d.opcode == 0x84) d.op = d.src16 ? DecodedOp::SubRR16 : DecodedOp::SubRI16;
+            else d.op = d.src16 ? DecodedOp::CmpRR16 : DecodedOp::CmpRI16;
+            d.nextIP = (uint16_t)(addr + 5);
+            break;
+        }
+        case 0x85: // Load r16
+            d.dst16 = reg16(fetch(1));
+            d.imm = word(2);
+            d.op = d.dst16 ? DecodedOp::Load16 : DecodedOp::Nop;
+            d.nextIP = (uint16_t)(addr + 4);
+            break;
+        case 0x86: // Store r16
+            d.imm = word(1);
+            d.src16 = reg16(fetch(3));
+            d.op = d.src16 ? DecodedOp::Store16 : DecodedOp::Nop;
+            d.nextIP = (uint16_t)(addr + 4);
+            break;
+        case 0x10: // INT
+            d.imm = fetch(1);
+            d.op = DecodedOp::Int;
+            d.nextIP = (uint16_t)(addr + 2);
+            break;
+        case 0x20: // PRINTN
+            d.imm = word(1);
+            d.op = DecodedOp::PrintN;
+            d.nextIP = (uint16_t)(addr + 3);
+            break;
+        case 0x30: // PUSH
+        {
+            uint8_t type = fetch(1);
+            d.imm = word(2);
+            if (type == 1) d.src16 = reg16(fetch(2)); // Unknown register pushes its raw ID
+            d.op = d.src16 ? DecodedOp::PushReg : DecodedOp::PushImm;
+            d.nextIP = (uint16_t)(addr + 4);
+            break;
+        }
+        case 0x31: // POP
+        {
+            uint16_t* dst = reg16(fetch(2));
+            d.dst16 = dst ? dst : &sink16;
+            d.op = DecodedOp::Pop;
+            d.nextIP = (uint16_t)(addr + 4);
+            break;
+        }
+        case 0x32: // CALL
+            d.imm = word(2);
+            d.op = DecodedOp::Call;
+            d.nextIP = (uint16_t)(addr + 4);
+            break;
+        case 0x33: // RET
+            d.op = DecodedOp::Ret;
+            d.nextIP = (uint16_t)(addr + 4);
+            break;
+        case 0x34: // PUSHF
+        case 0x35: // POPF
+            d.op = (d.opcode == 0x34) ? DecodedOp::PushF : DecodedOp::PopF;
+            d.nextIP = (uint16_t)(addr + 4);
+            break;
+        case 0x40: // JMP
+        case 0x41: // JZ
+        case 0x42: // JNZ
+            d.imm = word(2);
+            d.op = (d.opcode == 0x40) ? DecodedOp::Jmp : (d.opcode == 0x41) ? DecodedOp::Jz : DecodedOp::Jnz;
+            d.nextIP = (uint16_t)(addr + 4);
+            break;
+        case JCC_BASE + 0x0: case JCC_BASE + 0x1: case JCC_BASE + 0x2: case JCC_BASE + 0x3:
+        case JCC_BASE + 0x4: case JCC_BASE + 0x5: case JCC_BASE + 0x6: case JCC_BASE + 0x7:
+        case JCC_BASE + 0x8: case JCC_BASE + 0x9: case JCC_BASE + 0xA: case JCC_BASE + 0xB:
+        case JCC_BASE + 0xC: case JCC_BASE + 0xD: case JCC_BASE + 0xE: case JCC_BASE + 0xF:
+            d.imm = word(2);
+            // E/NE take the JZ/JNZ paths, which need no flags materialized
+            if (d.opcode == JCC_BASE + 0x4) d.op = DecodedOp::Jz;
+            else if (d.opcode == JCC_BASE + 0x5) d.op = DecodedOp::Jnz;
+            else d.op = DecodedOp::Jcc;
+            d.nextIP = (uint16_t)(addr + 4);
+            break;
+        case 0x50: // MUL r8
+        case 0x51: // DIV r8
+            d.src = reg8(fetch(1));
+            if (!d.src) d.op = DecodedOp::Nop;
+            else d.op = (d.opcode == 0x50) ? DecodedOp::Mul : DecodedOp::Div;
+            d.nextIP = (uint16_t)(addr + 3);
+            break;
+        case 0x15: // LEA
+            d.dst16 = reg16(fetch(1)); // LEA loads a 16-bit register: 0->AX, 2->BX, 4->CX, 6->DX
+            d.imm = word(2);
+            d.op = d.dst16 ? DecodedOp::Lea : DecodedOp::Nop;
+            d.nextIP = (uint16_t)(addr + 4);
+            break;
+        default:
+            d.op = DecodedOp::Invalid;
+            break;
+    }
+}
+
+// State at a stop point. Text: DEBUG|IP|AX|BX|CX|DX|SP|ZF|reason|FLAGS
+// (hex). Binary: 0xDB, u8 reason, u16 IP AX BX CX DX SP, u8 flags (bit0 ZF,
+// bit1 running, bits 2-6 CF PF AF SF OF), u32 cycles; little-endian, 19
+// bytes, no newline.
+void Simulator::reportState(DebugControl::StopReason reason) {
+    static const char* const REASONS[] = { "start", "step", "until", "write", "halt", "limit", "break", "watch" };
+    if (debug.binary) {
+        uint8_t frame[19];
+        uint16_t words[6] = { IP, regs.word(AX), regs.word(BX), regs.word(CX), regs.word(DX), SP };
+        frame[0] = 0xDB;
+        frame[1] = reason;
+        for (int i = 0; i < 6; i++) {
+            frame[2 + 2 * i] = words[i] & 0xFF;
+            frame[3 + 2 * i] = words[i] >> 8;
+        }
+        uint16_t f = flags.word();
+        frame[14] = ((f & FLAG_ZF) ? 1 : 0) | (running ? 2 : 0) | ((f & FLAG_CF) ? 4 : 0) | ((f & FLAG_PF) ? 8 : 0) |
+                    ((f & FLAG_AF) ? 16 : 0) | ((f & FLAG_SF) ? 32 : 0) | ((f & FLAG_OF) ? 64 : 0);
+        for (int i = 0; i < 4; i++) frame[15 + i] = (uint8_t)((uint32_t)cycles >> (8 * i));
+        out->write((const char*)frame, sizeof(frame));
+        out->flush();
+        return;
+    }
+    char line[64];
+    std::snprintf(line, sizeof(line), "DEBUG|%04x|%04x|%04x|%04x|%04x|%04x|%d|%s|%04x\n",
+                  IP, regs.word(AX), regs.word(BX), regs.word(CX), regs.word(DX), SP, flags.zf() ? 1 : 0, REASONS[reason],
+                  flags.word() | FLAGS_FIXED);
+    *out << line << std::flush;
+}
+
+void Simulator::reportWhere(uint16_t addr) {
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "WHERE|%04x|", addr);
+    *out << buf;
+    const LineEntry* line = debugInfo ? debugInfo->lineAt(addr) : nullptr;
+    if (line) {
+        *out << (line->file < debugInfo->files.size() ? debugInfo->files[line->file] : "") << "|" << line->line << "|";
+        if (line->macro && line->macro <= debugInfo->macros.size()) {
+            *out << debugInfo->macros[line->macro - 1] << "|" << line->macroLine;
+        } else {
+            *out << "|";
+        }
+    } else {
+        *out << "|||";
+    }
+    const ObjectSymbol* sym = debugInfo ? debugInfo->symbolAt(addr) : nullptr;
+    if (sym) *out << "|" << sym->name << "|" << (addr - sym->address);
+    else *out << "||";
+    *out << std::endl;
+}
+
+// Called before each instruction while debugging. Returns at once unless a
+// stop condition is met; then reports state and reads commands until one
+// resumes execution:
+//   s | step [n]              run n instructions (default 1)
+//   u | run-until <ip>        run until IP reaches ip (hex)
+//   w | run-until-write <a>   run until a write to address a (hex)
+//   c | continue | r          run at full speed to the next breakpoint or watch hit
+//   rs | reverse-step [n]     go back n instructions (default 1)
+//   rc | reverse-continue     go back to the previous breakpoint or watch hit
+//   b | break <a> [cond]      breakpoint at a, optionally only when cond holds
+//   bc | clear [a]            remove breakpoints at a, or all
+//   watch <a> [b] [r|w|rw]    watch range a..b for writes (default) or reads
+//   unwatch                   remove all watchpoints
+//   list                      BREAK|addr|cond and WATCH|first|last|mode lines
+//   where [a]                 WHERE|addr|file|line|macro|macroLine|symbol|offset
+//                             for a or IP; fields are empty when unknown,
+//                             including the file of an unnamed main source
+//   state                     report state again
+//   binary on|off             switch report format
+//   q                         quit
+bool Simulator::debugPrompt(bool& debugMode) {
+    if (!checkpoints.empty() && cycles - checkpoints.back().cycles >= CHECKPOINT_INTERVAL) checkpoint();
+
+    DebugControl::StopReason reason;
+    if (debug.watchHit) reason = DebugControl::Write;
+    else if (debug.watchpointHit) reason = DebugControl::Watch;
+    else if (debug.points.hasBreaks() && breakpointHit()) reason = DebugControl::Break;
+    else if (IP == debug.untilIP) reason = DebugControl::Until;
+    else if (debug.stepsLeft > 0 && --debug.stepsLeft == 0) reason = DebugControl::Step;
+    else if (debug.stepsLeft == 0) reason = DebugControl::Start;
+    else return true;
+
+    debug.watchHit = false;
+    debug.watchpointHit = false;
+    debug.watchAddr = -1;
+    debug.untilIP = -1;
+    debug.stepsLeft = 0;
+    debug.update();
+    if (!checkpoints.empty() && checkpoints.back().cycles != cycles) checkpoint();
+    io->flush(); // Program output up to the stop point comes before the report
+    reportState(reason);
+
+    auto hex = [](const std::string& s) { return (uint16_t)std::strtoul(s.c_str(), nullptr, 16); };
+    std::string line;
+    while (std::getline(*in, line)) {
+        std::istringstream words(line);
+        std::string cmd, word;
+        if (!(words >> cmd)) continue;
+        std::vector<std::string> args;
+        while (words >> word) args.push_back(word);
+        std::string arg = args.empty() ? std::string() : args[0];
+
+        if (cmd == "s" || cmd == "step") {
+            int n = arg.empty() ? 1 : std::atoi(arg.c_str());
+            debug.stepsLeft = n > 0 ? n : 1;
+            return true;
+        } else if ((cmd == "u" || cmd == "run-until") && !arg.empty()) {
+            debug.untilIP = hex(arg);
+            debug.stepsLeft = -1;
+            return true;
+        } else if ((cmd == "w" || cmd == "run-until-write") && !arg.empty()) {
+            debug.watchAddr = hex(arg);
+            debug.stepsLeft = -1;
+            debug.update();
+            return true;
+        } else if (cmd == "c" || cmd == "continue" || cmd == "r") {
+            debugMode = false;
+            return true;
+        } else if ((cmd == "rs" || cmd == "reverse-step") && !checkpoints.empty()) {
+            int n = arg.empty() ? 1 : std::atoi(arg.c_str());
+            reverseStep(n > 0 ? n : 1);
+            reason = DebugControl::Step;
+            reportState(reason);
+        } else if ((cmd == "rc" || cmd == "reverse-continue") && !checkpoints.empty()) {
+            reason = reverseContinue();
+            reportState(reason);
+        } else if ((cmd == "b" || cmd == "break") && !arg.empty()) {
+            std::string cond; // Spaces inside the condition are allowed
+            for (size_t i = 1; i < args.size(); i++) cond += args[i];
+            Breakpoint bp{ hex(arg), !cond.empty(), BreakCondition() };
+            if (bp.conditional && !BreakCondition::parse(cond, bp.condition)) {
+                *out << "DEBUG_ERROR|bad condition '" << cond << "'" << std::endl;
+                continue;
             }
-            case 0x50: // MUL r8
-            {
-                uint8_t srcID = memory[IP++];
-                IP++; // Skip 00
-                uint8_t srcVal = 0;
-                if (srcID == 0) srcVal = AX.L; else if (srcID == 1) srcVal = AX.H;
-                else if (srcID == 2) srcVal = BX.L; else if (srcID == 3) srcVal = BX.H;
-                else if (srcID == 4) srcVal = CX.L; else if (srcID == 5) srcVal = CX.H;
-                else if (srcID == 6) srcVal = DX.L; else if (srcID == 7) srcVal = DX.H;
-                
-                uint16_t res = (uint16_t)AX.L * (uint16_t)srcVal;
-                AX.X = res;
-                // Flags not fully implemented but ZF usually updated
-                ZF = (AX.X == 0);
-                break;
+            debug.points.addBreak(bp);
+            debug.update();
+        } else if (cmd == "bc" || cmd == "clear") {
+            if (arg.empty()) debug.points.clearBreaks();
+            else debug.points.removeBreak(hex(arg));
+            debug.update();
+        } else if (cmd == "watch" && !arg.empty()) {
+            // Optional end address, then mode
+            Watchpoint wp{ hex(arg), hex(arg), false, false };
+            std::string mode;
+            for (size_t i = 1; i < args.size(); i++) {
+                if (args[i] == "r" || args[i] == "w" || args[i] == "rw") mode = args[i];
+                else wp.last = hex(args[i]);
             }
-            case 0x51: // DIV r8
-            {
-                uint8_t srcID = memory[IP++];
-                IP++; // Skip 00
-                uint8_t srcVal = 0;
-                if (srcID == 0) srcVal = AX.L; else if (srcID == 1) srcVal = AX.H;
-                else if (srcID == 2) srcVal = BX.L; else if (srcID == 3) srcVal = BX.H;
-                else if (srcID == 4) srcVal = CX.L; else if (srcID == 5) srcVal = CX.H;
-                else if (srcID == 6) srcVal = DX.L; else if (srcID == 7) srcVal = DX.H;
-                
-                if (srcVal == 0) {
-                     std::cout << "Divide Error" << std::endl;
-                     running = false;
-                } else {
-                     AX.L = AX.X / srcVal; // Quotient
-                     AX.H = AX.X % srcVal; // Remainder
-                }
-                break;
+            if (wp.last < wp.first) std::swap(wp.first, wp.last);
+            wp.read = mode == "r" || mode == "rw";
+            wp.write = mode.empty() || mode == "w" || mode == "rw";
+            debug.points.addWatch(wp);
+            debug.update();
+        } else if (cmd == "unwatch") {
+            debug.points.clearWatches();
+            debug.update();
+        } else if (cmd == "list") {
+            char buf[64];
+            for (const Breakpoint& bp : debug.points.breakList()) {
+                std::snprintf(buf, sizeof(buf), "BREAK|%04x|", bp.address);
+                *out << buf << (bp.conditional ? bp.condition.text : "") << "\n";
             }
-            case 0x15: // LEA
-            {
-                uint8_t destID = memory[IP++];
-                uint16_t addr = memory[IP++];
-                addr |= (memory[IP++] << 8);
-                
-                if (destID == 0) AX.X = addr; // Usually LEA loads to 16-bit reg, we map 0->AX
-                else if (destID == 2) BX.X = addr;
-                else if (destID == 4) CX.X = addr;
-                else if (destID == 6) DX.X = addr;
-                break;
+            for (const Watchpoint& wp : debug.points.watchList()) {
+                std::snprintf(buf, sizeof(buf), "WATCH|%04x|%04x|%s%s\n", wp.first, wp.last, wp.read ? "r" : "", wp.write ? "w" : "");
+                *out << buf;
             }
-            default: running = false; break;
+            *out << "LIST_END" << std::endl;
+        } else if (cmd == "where") {
+            reportWhere(arg.empty() ? IP : hex(arg));
+        } else if (cmd == "state") {
+            reportState(reason);
+        } else if (cmd == "binary") {
+            debug.binary = (arg == "on");
+        } else if (cmd == "q" || cmd == "quit") {
+            break;
+        } else {
+            *out << "DEBUG_ERROR|unknown command '" << cmd << "'" << std::endl;
         }
-        cycles++;
     }
-    if (!debugMode) {
-        std::cout << "\n--- Simulation Finished ---" << std::endl;
-        std::cout << "Press Enter to exit..." << std::endl;
-        std::cin.ignore();
-        std::cin.get();
+    // Quit, or end of input
+    debug.quit = true;
+    running = false;
+    termination = Termination::Quit;
+    return false;
+}
+
+char Simulator::readInput() {
+    if (inputPos < inputHistory.size()) return inputHistory[inputPos++];
+    char c = 0;
+    io->flush(); // Prompts and output so far must be visible first
+    io->readChar(c); // 0 once input is exhausted
+    inputHistory += c;
+    inputPos++;
+    return c;
+}
+
+void Simulator::interrupt(uint8_t intNo, bool debugMode) {
+    if (intNo == 0x21) {
+        if (regs.byte(AH) == 0x4C) {
+            running = false;
+            termination = Termination::Exit;
+        }
+        else if (regs.byte(AH) == 0x01) {
+            if (!debugMode) io->write("Input Required: ");
+            char c = readInput();
+            io->put(c);
+            io->put('\n');
+            regs.byte(AL) = c;
+        }
+        else if (regs.byte(AH) == 0x02) io->put((char)regs.byte(DL));
+        else if (regs.byte(AH) == 0x09) { // String Print
+             uint16_t addr = (regs.word(DX)); // Using DS:DX (DS implied same segment)
+             // Since our memory model is flat for now (small model), DX is offset
+             while (addr < memory.size() && memory[addr] != '$') {
+                 if (debug.watching) noteRead(addr);
+                 io->put((char)memory[addr++]);
+             }
+        }
+    }
+}
+
+void Simulator::printString(uint16_t addr) {
+    while (memory[addr] != 0 && memory[addr] != '$') {
+        if (debug.watching) noteRead(addr);
+        io->put((char)memory[addr++]);
+    }
+    io->put('\n');
+}
+
+// Flags are undefined after DIV on the 8086; they are left unchanged
+void Simulator::divide(uint8_t srcVal) {
+    if (srcVal == 0) {
+         io->write("Divide Error\n");
+         running = false;
+         termination = Termination::DivideError;
+         faultIP = (uint16_t)(IP - 3); // DIV r8 is 3 bytes
+         faultOpcode = 0x51;
+    } else {
+         regs.byte(AL) = regs.word(AX) / srcVal; // Quotient
+         regs.byte(AH) = regs.word(AX) % srcVal; // Remainder
+    }
+}
+
+void Simulator::invalidOpcode(uint8_t opcode) {
+    running = false;
+    termination = Termination::InvalidOpcode;
+    faultIP = (uint16_t)(IP - 1); // Invalid entries decode as 1 byte long
+    faultOpcode = opcode;
+}
+
+const char* terminationName(Termination t) {
+    switch (t) {
+        case Termination::None: return "running";
+        case Termination::Exit: return "exit";
+        case Termination::CycleLimit: return "cycle_limit";
+        case Termination::TimeLimit: return "time_limit";
+        case Termination::InvalidOpcode: return "invalid_opcode";
+        case Termination::DivideError: return "divide_error";
+        case Termination::Quit: return "quit";
     }
+    return "unknown";
+}
+
+void Simulator::setCycleLimit(int limit) {
+    maxCycles = limit > 0 ? limit : INT_MAX;
+}
+
+void Simulator::setTimeLimit(double seconds) {
+    timeLimit = seconds > 0 ? seconds : 0;
+}
+
+RunStats Simulator::stats() const {
+    return RunStats{ termination, cycles, elapsed, faultIP, faultOpcode };
+}
+
+void Simulator::start() {
+    running = true;
+    cycles = 0;
+    elapsed = 0;
+    termination = Termination::None;
+    if (SP == 0) SP = 0xFFFE;
+    clearCheckpoints();
+    inputHistory.clear();
+    inputPos = 0;
+}
+
+int Simulator::step(int count) {
+    if (!running || count <= 0) return 0;
+    int before = cycles;
+    bool debugMode = false;
+    execute(debugMode, Engine::Switch, count < maxCycles - cycles ? cycles + count : maxCycles);
+    io->flush();
+    return cycles - before;
+}
+
+void Simulator::execute(bool& debugMode, Engine engine, int cycleLimit) {
+    bool timed = timeLimit > 0 && !debugMode; // Time at the debug prompt does not count
+    for (;;) {
+        auto begin = std::chrono::steady_clock::now();
+        int limit = timed && cycleLimit - cycles > TIME_SLICE ? cycles + TIME_SLICE : cycleLimit;
+        if (profiler || tracer) runSwitch(debugMode, limit);
+        else if (engine == Engine::Threaded) ThreadedEngine::run(*this, debugMode, limit);
+        else if (engine == Engine::Block) BlockEngine::run(*this, debugMode, limit);
+        else if (engine == Engine::Jit) JitEngine::run(*this, debugMode, limit);
+        else runSwitch(debugMode, limit);
+        elapsed += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        if (!running || cycles >= cycleLimit) break;
+        if (timed && elapsed >= timeLimit) {
+            running = false;
+            termination = Termination::TimeLimit;
+            break;
+        }
+    }
+    if (running && cycles >= maxCycles) termination = Termination::CycleLimit;
+}
+
+void Simulator::run(bool debugMode, Engine engine) {
+    start();
+    bool debugSession = debugMode;
+    if (debugSession) {
+        debug = DebugControl();
+        checkpoint(); // Reverse execution can always get back to the start
+        *out << "DEBUG_MODE_START" << std::endl;
+    }
+
+    execute(debugMode, engine, maxCycles);
+    io->flush();
+
+    // Final stop point, also after continue
+    if (debugSession && !debug.quit) reportState(cycles >= maxCycles ? DebugControl::CycleLimit : DebugControl::Halt);
+}
+
+// One instruction on the switch engine; inlined into the loops below
+inline void Simulator::executeOne(bool debugMode) {
+    DecodedInstr& d = decodeCache[IP];
+    if (d.op == DecodedOp::NotDecoded) decode(IP, d);
+    IP = d.nextIP;
+
+    switch (d.op) {
+        case DecodedOp::Nop: break;
+        case DecodedOp::MovRI: *d.dst = (uint8_t)d.imm; break;
+        case DecodedOp::MovRR: *d.dst = *d.src; break;
+        case DecodedOp::AddRI: *d.dst = flags.add8(*d.dst, (uint8_t)d.imm); break;
+        case DecodedOp::AddRR: *d.dst = flags.add8(*d.dst, *d.src); break;
+        case DecodedOp::SubRI: *d.dst = flags.sub8(*d.dst, (uint8_t)d.imm); break;
+        case DecodedOp::SubRR: *d.dst = flags.sub8(*d.dst, *d.src); break;
+        case DecodedOp::CmpRI: flags.sub8(*d.dst, (uint8_t)d.imm); break;
+        case DecodedOp::CmpRR: flags.sub8(*d.dst, *d.src); break;
+        case DecodedOp::Load:
+            *d.dst = memory[d.imm];
+            if (debug.watching) noteRead(d.imm);
+            break;
+        case DecodedOp::Store: writeByte(d.imm, *d.src); break;
+        case DecodedOp::MovRI16: *d.dst16 = d.imm; break;
+        case DecodedOp::MovRR16: *d.dst16 = *d.src16; break;
+        case DecodedOp::AddRI16: *d.dst16 = flags.add16(*d.dst16, d.imm); break;
+        case DecodedOp::AddRR16: *d.dst16 = flags.add16(*d.dst16, *d.src16); break;
+        case DecodedOp::SubRI16: *d.dst16 = flags.sub16(*d.dst16, d.imm); break;
+        case DecodedOp::SubRR16: *d.dst16 = flags.sub16(*d.dst16, *d.src16); break;
+        case DecodedOp::CmpRI16: flags.sub16(*d.dst16, d.imm); break;
+        case DecodedOp::CmpRR16: flags.sub16(*d.dst16, *d.src16); break;
+        case DecodedOp::Load16:
+            *d.dst16 = readWord(d.imm);
+            if (debug.watching) { noteRead(d.imm); noteRead((uint16_t)(d.imm + 1)); }
+            break;
+        case DecodedOp::Store16: writeWord(d.imm, *d.src16); break;
+        case DecodedOp::Int: interrupt((uint8_t)d.imm, debugMode); break;
+        case DecodedOp::PrintN: printString(d.imm); break;
+        case DecodedOp::PushImm: push(d.imm); break;
+        case DecodedOp::PushReg: push(*d.src16); break;
+        case DecodedOp::Pop: *d.dst16 = pop(); break;
+        case DecodedOp::PushF: push(flags.word() | FLAGS_FIXED); break;
+        case DecodedOp::PopF: flags.set(pop()); break;
+        case DecodedOp::Call: push(IP); IP = d.imm; break;
+        case DecodedOp::Ret: IP = pop(); break;
+        case DecodedOp::Jmp: IP = d.imm; break;
+        case DecodedOp::Jz: if (flags.zf()) IP = d.imm; break;
+        case DecodedOp::Jnz: if (!flags.zf()) IP = d.imm; break;
+        case DecodedOp::Jcc: if (flags.test(d.opcode & 0x0F)) IP = d.imm; break;
+        case DecodedOp::Mul: regs.word(AX) = flags.mul8(regs.byte(AL), *d.src); break;
+        case DecodedOp::Div: divide(*d.src); break;
+        case DecodedOp::Lea: *d.dst16 = d.imm; break;
+        default: invalidOpcode(d.opcode); break;
+    }
+    cycles++;
+}
+
+// Re-executes up to cycle target with output discarded and input taken
+// from the history. With hits, records every stop a breakpoint (before
+// the instruction) or watchpoint (after it) would have caused, by cycle.
+void Simulator::replayTo(int target, std::vector<std::pair<int, DebugControl::StopReason>>* hits) {
+    IODevice* device = io;
+    NullDevice discard;
+    io = &discard;
+    Tracer* traced = tracer; // Re-executed instructions are not traced again
+    tracer = nullptr;
+    while (running && cycles < target) {
+        if (hits && debug.points.hasBreaks() && breakpointHit()) hits->emplace_back(cycles, DebugControl::Break);
+        executeOne(true);
+        if (debug.watchpointHit) {
+            if (hits) hits->emplace_back(cycles, DebugControl::Watch);
+            debug.watchpointHit = false;
+        }
+    }
+    debug.watchHit = false;
+    io = device;
+    tracer = traced;
+}
+
+// Back count instructions from the nearest earlier checkpoint
+void Simulator::reverseStep(int count) {
+    int target = cycles - count > 0 ? cycles - count : 0;
+    size_t k = checkpoints.size() - 1;
+    while (k > 0 && checkpoints[k].cycles > target) k--;
+    restore(k);
+    replayTo(target, nullptr);
+}
+
+// Back to the latest breakpoint or watchpoint stop before now, searching
+// one checkpoint interval at a time, newest first; else to the start
+DebugControl::StopReason Simulator::reverseContinue() {
+    int now = cycles;
+    for (size_t k = checkpoints.size(); k-- > 0; ) {
+        int end = k + 1 < checkpoints.size() ? checkpoints[k + 1].cycles : now;
+        std::vector<std::pair<int, DebugControl::StopReason>> hits;
+        restore(k);
+        replayTo(end, &hits);
+        while (!hits.empty() && hits.back().first >= now) hits.pop_back();
+        if (!hits.empty()) {
+            restore(k);
+            replayTo(hits.back().first, nullptr);
+            return hits.back().second;
+        }
+    }
+    restore(0);
+    return DebugControl::Start;
+}
+
+// Reference engine: one switch over the decoded op per instruction
+void Simulator::runSwitch(bool& debugMode, int cycleLimit) {
+    while (running && cycles < cycleLimit) {
+        if (debugMode || debug.armed) {
+            // Free-running: drop back to the prompt at a breakpoint or after a watch hit
+            if (!debugMode && (debug.watchHit || debug.watchpointHit || breakpointHit())) debugMode = true;
+            if (debugMode && !debugPrompt(debugMode)) break;
+        }
+        if (profiler || tracer) instrumentedStep(debugMode);
+        else executeOne(debugMode);
+    }
+}
+
+void Simulator::instrumentedStep(bool debugMode) {
+    uint16_t at = IP;
+    DecodedInstr& d = decodeCache[at];
+    if (d.op == DecodedOp::NotDecoded) decode(at, d);
+    DecodedOp op = d.op; // The entry may be invalidated by the instruction itself
+    uint16_t target = d.imm;
+    if (tracer) tracer->begin(at, memory[at]);
+    executeOne(debugMode);
+    if (tracer) tracer->end(regs, SP, flags.word());
+    if (profiler) profiler->record(at, op, (op == DecodedOp::Jz || op == DecodedOp::Jnz || op == DecodedOp::Jcc) && IP == target);
 }
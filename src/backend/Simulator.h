@@ -9,14 +9,136 @@
 #include <iomanip>
 #include <map>
 #include <cstdint>
+#include <memory>
+#include "Breakpoints.h"
+#include "Snapshot.h"
+#include "IODevice.h"
+#include "Flags.h"
 
-// 8086 Register Structure
-union Register {
-    uint16_t X;
-    struct {
-        uint8_t L;
-        uint8_t H;
+class ObjectImage;
+class Profiler;
+class BlockCache;
+class JitCache;
+class Tracer;
+
+// Encoded register IDs. Byte IDs index the register file directly; a word
+// register is encoded as the ID of its low byte.
+enum Reg8 : uint8_t { AL = 0, AH, BL, BH, CL, CH, DL, DH };
+enum Reg16 : uint8_t { AX = 0, BX = 2, CX = 4, DX = 6 };
+
+// 8086 register file: AL AH BL BH CL CH DL DH stored contiguously, so AX..DX
+// overlay byte pairs (little-endian host, as with the old Register union).
+struct RegisterFile {
+    union {
+        uint8_t b[8];
+        uint16_t w[4];
     };
+
+    constexpr uint8_t& byte(uint8_t id) { return b[id & 7]; }
+    constexpr uint16_t& word(uint8_t id) { return w[(id >> 1) & 3]; }
+    constexpr uint16_t word(uint8_t id) const { return w[(id >> 1) & 3]; }
+};
+
+// Decoded operation kinds. Register/immediate forms of the same opcode are
+// split so the execution loop never re-inspects operand type bytes.
+enum class DecodedOp : uint8_t {
+    NotDecoded,
+    Nop,
+    MovRI, MovRR,
+    AddRI, AddRR, SubRI, SubRR,
+    CmpRI, CmpRR,
+    Load, Store,
+    // Word-sized forms, on dst16/src16
+    MovRI16, MovRR16,
+    AddRI16, AddRR16, SubRI16, SubRR16,
+    CmpRI16, CmpRR16,
+    Load16, Store16,
+    Int, PrintN,
+    PushImm, PushReg, Pop, PushF, PopF,
+    Call, Ret,
+    Jmp, Jz, Jnz, Jcc, // Jcc: condition in the low nibble of opcode
+    Mul, Div,
+    Lea,
+    Invalid,
+    Count
+};
+
+// Execution engines selectable at run time
+enum class Engine {
+    Switch,   // Reference: switch over the decoded op
+    Threaded, // Handler table (computed goto where available)
+    Block,    // Compiled basic blocks with fused pairs (see BlockEngine)
+    Jit       // Native x86-64 code (see JitEngine)
+};
+
+// One pre-decoded instruction, cached per start address
+struct DecodedInstr {
+    uint8_t* dst;          // Resolved 8-bit destination register
+    const uint8_t* src;    // Resolved 8-bit source register
+    uint16_t* dst16;       // Resolved 16-bit destination (word ops, POP, LEA)
+    const uint16_t* src16; // Resolved 16-bit source (word ops, PUSH)
+    uint16_t imm;          // Immediate, memory address or jump target
+    uint16_t nextIP;       // Address of the following instruction
+    DecodedOp op;
+    uint8_t opcode;        // Raw opcode byte as stored in memory
+};
+
+// Stop conditions for the debug protocol (see Simulator::debugPrompt).
+// Between stop points instructions run without any I/O.
+struct DebugControl {
+    enum StopReason : uint8_t { Start, Step, Until, Write, Halt, CycleLimit, Break, Watch };
+
+    int stepsLeft = 0;    // Instructions before the next stop; -1 = no step limit
+    int untilIP = -1;     // Stop when IP reaches this address
+    int watchAddr = -1;   // Stop after an instruction writes this byte
+    bool watchHit = false;
+    bool binary = false;  // Report state as binary frames instead of DEBUG| lines
+    bool quit = false;
+
+    Breakpoints points;
+    bool watchpointHit = false;
+    bool watching = false; // watchAddr or any watchpoint set: memory accesses are checked
+    bool armed = false;    // Free-running engines must check for breakpoints and watch hits
+
+    void update() {
+        watching = watchAddr >= 0 || points.hasWatches();
+        armed = watching || points.hasBreaks();
+    }
+};
+
+// Why a program stopped
+enum class Termination : uint8_t {
+    None,          // Still running, or not started
+    Exit,          // INT 21h AH=4Ch
+    CycleLimit,
+    TimeLimit,
+    InvalidOpcode, // At RunStats::faultIP
+    DivideError,   // At RunStats::faultIP
+    Quit           // Debug session ended by the user
+};
+
+const char* terminationName(Termination t); // "exit", "cycle_limit", ...
+
+// End-of-run report
+struct RunStats {
+    Termination termination;
+    int instructions;
+    double seconds;      // Wall time spent executing
+    uint16_t faultIP;    // Address of the faulting instruction
+    uint8_t faultOpcode;
+
+    double mips() const { return seconds > 0 ? instructions / seconds / 1e6 : 0; }
+};
+
+// Registers and counters saved with each checkpoint
+struct CpuState {
+    RegisterFile regs;
+    uint16_t IP;
+    uint16_t SP;
+    LazyFlags flags;
+    bool running;
+    int cycles;
+    size_t inputPos; // Console input consumed so far
 };
 
 class Simulator {
@@ -26,13 +148,69 @@ private:
                                  // emu8086 is byte-addressable. "Hello" is bytes. 
                                  // Let's us byte memory [65536].
     
-    Register AX, BX, CX, DX;
+    RegisterFile regs;
     uint16_t IP; // Instruction Pointer (PC)
     uint16_t SP; // Stack Pointer
     
-    // Flags
-    bool ZF; // Zero Flag
+    LazyFlags flags;
     bool running;
+    int maxCycles;
+    int cycles;
+
+    // Wall-clock limit in seconds (0 = none), checked every TIME_SLICE cycles
+    double timeLimit;
+    double elapsed;
+    static const int TIME_SLICE = 1 << 20;
+    Termination termination;
+    uint16_t faultIP;
+    uint8_t faultOpcode;
+
+    // Decode cache: one entry per address, filled lazily the first time IP
+    // reaches it. Any memory write invalidates entries overlapping the byte.
+    std::vector<DecodedInstr> decodeCache;
+    uint16_t sink16;   // Discard target for unresolvable 16-bit writes
+
+    // Compiled code of the block and JIT engines, created on first use.
+    // codeMap has a bit for every byte of compiled code; a write to a marked
+    // byte sets codeStale, and those engines call flushCode() at their next
+    // block boundary.
+    std::unique_ptr<BlockCache> blocks;
+    std::unique_ptr<JitCache> jit;
+    uint64_t codeMap[65536 / 64];
+    bool codeStale;
+
+    DebugControl debug;
+
+    // Checkpoints: CPU state here, memory pages in the journal
+    PageJournal journal;
+    std::vector<CpuState> checkpoints;
+    static const int CHECKPOINT_INTERVAL = 256; // Cycles between automatic checkpoints while debugging
+
+    // Characters read by INT 21h/01. Re-execution after a restore reads
+    // from here, so replayed runs see the same input.
+    std::string inputHistory;
+    size_t inputPos;
+
+    Profiler* profiler;
+    Tracer* tracer;
+    const ObjectImage* debugInfo;
+
+    // Debug protocol streams
+    std::istream* in;
+    std::ostream* out;
+    // Program I/O: INT 21h and PRINTN
+    ConsoleDevice console;
+    IODevice* io;
+
+    void decode(uint16_t addr, DecodedInstr& d);
+    void invalidate(uint16_t addr);
+    void clearDecoded(); // After memory changed wholesale
+    void flushCode();    // Drops compiled code and clears codeMap
+    void markCode(uint16_t start, uint16_t end); // Bytes [start, end) were compiled
+    void writeByte(uint16_t addr, uint8_t val);
+    // Little-endian word at addr; addr FFFF wraps to 0000
+    uint16_t readWord(uint16_t addr) const;
+    void writeWord(uint16_t addr, uint16_t val);
 
     int getRegisterValue(const std::string& regName);
     void setRegisterValue(const std::string& regName, int value);
@@ -43,10 +221,94 @@ private:
     void push(uint16_t val);
     uint16_t pop();
 
+    // Instruction helpers shared by all engines
+    bool debugPrompt(bool& debugMode); // false when the user quits
+    void reportState(DebugControl::StopReason reason);
+    void reportWhere(uint16_t addr);
+    bool breakpointHit(); // A breakpoint at IP whose condition holds
+    void noteRead(uint16_t addr);
+    void noteWrite(uint16_t addr);
+    char readInput();
+    void interrupt(uint8_t intNo, bool debugMode);
+    void printString(uint16_t addr);
+    void divide(uint8_t srcVal);
+    void invalidOpcode(uint8_t opcode);
+
+    // Reverse execution: restore a checkpoint, then re-execute silently
+    void replayTo(int target, std::vector<std::pair<int, DebugControl::StopReason>>* hits);
+    void reverseStep(int count);
+    DebugControl::StopReason reverseContinue();
+
+    void executeOne(bool debugMode);
+    void instrumentedStep(bool debugMode);
+    void runSwitch(bool& debugMode, int cycleLimit);
+    // Runs an engine up to cycleLimit, in time slices when a time limit is set
+    void execute(bool& debugMode, Engine engine, int cycleLimit);
+    friend struct ThreadedEngine;
+    friend struct BlockEngine;
+    friend struct JitEngine;
+
 public:
     Simulator(int memorySize = 65536);
+    ~Simulator();
+    // Decoded entries point into this object's registers
+    Simulator(const Simulator&) = delete;
+    Simulator& operator=(const Simulator&) = delete;
+
+    // Clears memory, registers and the decode cache
+    void reset();
     bool load(const std::string& objectFile);
-    void run(bool debugMode = false);
+    bool loadImage(const ObjectImage& image);
+    bool loadImage(const uint8_t* data, size_t size); // Serialized binary image
+    // Redirects the debug protocol and the console device (std::cin/std::cout
+    // by default) and makes the console the program's device; both streams
+    // must outlive run()
+    void setConsole(std::istream& input, std::ostream& output);
+    // Program I/O through another device, which must outlive run()
+    void setDevice(IODevice& device);
+    // Counts every instruction executed from now on; nullptr detaches.
+    // Profiled runs use the switch engine.
+    void setProfiler(Profiler* p) { profiler = p; }
+    // Logs every instruction from now on into the tracer's ring; nullptr
+    // detaches. Traced runs use the switch engine.
+    void setTracer(Tracer* t) { tracer = t; }
+    // Line table and symbols for the debug "where" command; nullptr for none.
+    // The image must outlive run().
+    void setDebugInfo(const ObjectImage* image) { debugInfo = image; }
+    void run(bool debugMode = false, Engine engine = Engine::Switch);
+
+    // Incremental execution for embedders: start() readies a loaded program,
+    // step() runs up to count instructions on the switch engine and returns
+    // how many executed
+    void start();
+    int step(int count);
+
+    // Snapshots. checkpoint() records the current state and returns its
+    // index; restore() rolls back to it and discards later checkpoints.
+    // Memory is tracked per page from the first checkpoint on.
+    size_t checkpoint();
+    bool restore(size_t index);
+    void clearCheckpoints();
+    size_t checkpointCount() const { return checkpoints.size(); }
+
+    // Limits for later runs: cycles <= 0 or seconds <= 0 means none. The
+    // default is 5000 cycles and no time limit. Debug sessions ignore the
+    // time limit.
+    void setCycleLimit(int limit);
+    void setTimeLimit(double seconds);
+    RunStats stats() const;
+
+    int cycleCount() const { return cycles; }
+    bool cycleLimitReached() const { return cycles >= maxCycles; }
+    bool isRunning() const { return running && cycles < maxCycles; }
+
+    uint16_t getIP() const { return IP; }
+    uint16_t getSP() const { return SP; }
+    bool getZF() const { return flags.zf(); }
+    uint16_t getFlags() const { return flags.word(); }
+    uint16_t getRegister(Reg16 r) const { return regs.word(r); }
+    const uint8_t* memoryData() const { return memory.data(); }
+    size_t memorySize() const { return memory.size(); }
 };
 
 #endif
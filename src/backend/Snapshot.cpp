@@ -0,0 +1,20 @@
+#include "Snapshot.h"
+
+void PageJournal::savePage(unsigned page, const uint8_t* memory) {
+    Interval& iv = intervals.back();
+    const uint8_t* src = memory + ((size_t)page << PAGE_BITS);
+    iv.pages.push_back((uint8_t)page);
+    iv.saved.insert(iv.saved.end(), src, src + PAGE_SIZE);
+    dirty[page >> 6] |= (uint64_t)1 << (page & 63);
+}
+
+size_t PageJournal::mark() {
+    intervals.emplace_back();
+    for (auto& w : dirty) w = 0;
+    return intervals.size() - 1;
+}
+
+void PageJournal::clear() {
+    intervals.clear();
+    for (auto& w : dirty) w = 0;
+}
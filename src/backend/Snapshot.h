@@ -0,0 +1,66 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Copy-on-write journal of memory pages between checkpoints. mark() opens
+// a new checkpoint; the first write to a page after that saves the page as
+// it was, so a checkpoint costs only the pages changed since the previous
+// one. rollback() copies saved pages back, newest first.
+class PageJournal {
+public:
+    static const unsigned PAGE_BITS = 8;
+    static const unsigned PAGE_SIZE = 1u << PAGE_BITS;
+    static const unsigned PAGE_COUNT = 65536 / PAGE_SIZE;
+
+private:
+    // Pages first written after a checkpoint, with their contents at it
+    struct Interval {
+        std::vector<uint8_t> pages;
+        std::vector<uint8_t> saved;
+    };
+    std::vector<Interval> intervals;
+    uint64_t dirty[PAGE_COUNT / 64]; // Pages already saved in the newest interval
+
+    void savePage(unsigned page, const uint8_t* memory);
+
+public:
+    PageJournal() { clear(); }
+
+    bool tracking() const { return !intervals.empty(); }
+    size_t size() const { return intervals.size(); }
+
+    // Must run before every byte written to memory while tracking
+    void beforeWrite(uint16_t addr, const uint8_t* memory) {
+        unsigned page = addr >> PAGE_BITS;
+        if (!((dirty[page >> 6] >> (page & 63)) & 1)) savePage(page, memory);
+    }
+
+    // Opens checkpoint size(); memory must be 64 KiB
+    size_t mark();
+    // Restores memory to checkpoint index and drops later checkpoints.
+    // restored(page) runs once per page copied back.
+    template <class F>
+    void rollback(size_t index, uint8_t* memory, F restored);
+    void clear();
+};
+
+template <class F>
+void PageJournal::rollback(size_t index, uint8_t* memory, F restored) {
+    for (size_t i = intervals.size(); i-- > index; ) {
+        const Interval& iv = intervals[i];
+        for (size_t k = 0; k < iv.pages.size(); k++) {
+            const uint8_t* src = iv.saved.data() + k * PAGE_SIZE;
+            std::copy(src, src + PAGE_SIZE, memory + ((size_t)iv.pages[k] << PAGE_BITS));
+            restored(iv.pages[k]);
+        }
+    }
+    intervals.resize(index + 1);
+    intervals[index].pages.clear();
+    intervals[index].saved.clear();
+    for (auto& w : dirty) w = 0;
+}
+
+#endif
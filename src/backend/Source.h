@@ -0,0 +1,38 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <string>
+#include <string_view>
+
+// One line of (macro-expanded) source, tagged with its original line number.
+// The text views either the caller's source buffer or macro expansion output.
+// file names the INCLUDE file the line came from, or is nullptr for the main input.
+// Lines produced by a macro call carry the call's line number, plus the
+// innermost macro that produced them and the line within its body (from 1).
+struct SourceLine {
+    std::string_view text;
+    int line;
+    const std::string* file = nullptr;
+    std::string_view macro;
+    int macroLine = 0;
+};
+
+// Assembler/macro-processor message attached to a source line
+struct Diagnostic {
+    enum Severity { Warning, Error };
+    Severity severity;
+    int line;
+    std::string message;
+    std::string file; // Include file, or empty for the main input
+};
+
+// Diagnostic::file for a SourceLine::file
+inline std::string sourceName(const std::string* file) { return file ? *file : std::string(); }
+
+// "file:line: error: message", naming mainFile for lines of the main input
+inline std::string formatDiagnostic(const Diagnostic& d, const std::string& mainFile) {
+    return (d.file.empty() ? mainFile : d.file) + ":" + std::to_string(d.line) + ": "
+        + (d.severity == Diagnostic::Error ? "error: " : "warning: ") + d.message;
+}
+
+#endif
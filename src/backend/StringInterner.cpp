@@ -0,0 +1,52 @@
+#include "StringInterner.h"
+#include <cstring>
+
+StringInterner::StringInterner() : current(nullptr), chunkUsed(0) {}
+
+std::string_view StringInterner::store(std::string_view s) {
+    char* p;
+    if (s.size() > CHUNK_SIZE / 4) {
+        // Oversized strings get a chunk of their own; the current one stays active
+        chunks.emplace_back(new char[s.size()]);
+        p = chunks.back().get();
+    } else {
+        if (!current || chunkUsed + s.size() > CHUNK_SIZE) {
+            chunks.emplace_back(new char[CHUNK_SIZE]);
+            current = chunks.back().get();
+            chunkUsed = 0;
+        }
+        p = current + chunkUsed;
+        chunkUsed += s.size();
+    }
+    std::memcpy(p, s.data(), s.size());
+    return std::string_view(p, s.size());
+}
+
+uint32_t StringInterner::intern(std::string_view s) {
+    if (const uint32_t* id = ids.find(s)) return *id;
+    std::string_view stored = store(s);
+    uint32_t id = (uint32_t)names.size();
+    names.push_back(stored);
+    ids[stored] = id;
+    return id;
+}
+
+bool StringInterner::find(std::string_view s, uint32_t& id) const {
+    const uint32_t* found = ids.find(s);
+    if (!found) return false;
+    id = *found;
+    return true;
+}
+
+void StringInterner::reserve(size_t n) {
+    names.reserve(n);
+    ids.reserve(n);
+}
+
+void StringInterner::clear() {
+    chunks.clear();
+    current = nullptr;
+    chunkUsed = 0;
+    names.clear();
+    ids.clear();
+}
@@ -0,0 +1,39 @@
+#ifndef STRINGINTERNER_H
+#define STRINGINTERNER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+#include "FlatHashMap.h"
+
+// Maps each distinct string to a dense ID. Characters are copied once into
+// an arena of fixed-size chunks, so returned views stay valid until clear().
+class StringInterner {
+private:
+    static const size_t CHUNK_SIZE = 4096;
+
+    std::vector<std::unique_ptr<char[]>> chunks;
+    char* current;      // Chunk receiving small strings
+    size_t chunkUsed;
+    std::vector<std::string_view> names;
+    FlatHashMap<std::string_view, uint32_t> ids;
+
+    std::string_view store(std::string_view s);
+
+public:
+    StringInterner();
+    StringInterner(const StringInterner&) = delete;
+    StringInterner& operator=(const StringInterner&) = delete;
+
+    uint32_t intern(std::string_view s);
+    // False if s has never been interned
+    bool find(std::string_view s, uint32_t& id) const;
+    std::string_view name(uint32_t id) const { return names[id]; }
+    size_t size() const { return names.size(); }
+    void reserve(size_t n);
+    void clear();
+};
+
+#endif
@@ -0,0 +1,179 @@
+#include "ThreadedEngine.h"
+
+// Ops with a dedicated handler. NotDecoded and Invalid are handled by the
+// dispatch loop itself.
+#define TITAN_HANDLED_OPS(X) \
+    X(Nop) X(MovRI) X(MovRR) \
+    X(AddRI) X(AddRR) X(SubRI) X(SubRR) \
+    X(CmpRI) X(CmpRR) \
+    X(Load) X(Store) \
+    X(MovRI16) X(MovRR16) \
+    X(AddRI16) X(AddRR16) X(SubRI16) X(SubRR16) \
+    X(CmpRI16) X(CmpRR16) \
+    X(Load16) X(Store16) \
+    X(Int) X(PrintN) \
+    X(PushImm) X(PushReg) X(Pop) X(PushF) X(PopF) \
+    X(Call) X(Ret) \
+    X(Jmp) X(Jz) X(Jnz) X(Jcc) \
+    X(Mul) X(Div) \
+    X(Lea)
+
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(TITAN_NO_COMPUTED_GOTO)
+#define TITAN_COMPUTED_GOTO 1
+#endif
+
+#define TITAN_HANDLER(op) \
+    template <> inline void ThreadedEngine::exec<DecodedOp::op>( \
+        [[maybe_unused]] Simulator& s, [[maybe_unused]] const DecodedInstr& d, [[maybe_unused]] bool debugMode)
+
+TITAN_HANDLER(Nop) {}
+TITAN_HANDLER(MovRI) { *d.dst = (uint8_t)d.imm; }
+TITAN_HANDLER(MovRR) { *d.dst = *d.src; }
+TITAN_HANDLER(AddRI) { *d.dst = s.flags.add8(*d.dst, (uint8_t)d.imm); }
+TITAN_HANDLER(AddRR) { *d.dst = s.flags.add8(*d.dst, *d.src); }
+TITAN_HANDLER(SubRI) { *d.dst = s.flags.sub8(*d.dst, (uint8_t)d.imm); }
+TITAN_HANDLER(SubRR) { *d.dst = s.flags.sub8(*d.dst, *d.src); }
+TITAN_HANDLER(CmpRI) { s.flags.sub8(*d.dst, (uint8_t)d.imm); }
+TITAN_HANDLER(CmpRR) { s.flags.sub8(*d.dst, *d.src); }
+TITAN_HANDLER(Load) { *d.dst = s.memory[d.imm]; if (s.debug.watching) s.noteRead(d.imm); }
+TITAN_HANDLER(Store) { s.writeByte(d.imm, *d.src); }
+TITAN_HANDLER(MovRI16) { *d.dst16 = d.imm; }
+TITAN_HANDLER(MovRR16) { *d.dst16 = *d.src16; }
+TITAN_HANDLER(AddRI16) { *d.dst16 = s.flags.add16(*d.dst16, d.imm); }
+TITAN_HANDLER(AddRR16) { *d.dst16 = s.flags.add16(*d.dst16, *d.src16); }
+TITAN_HANDLER(SubRI16) { *d.dst16 = s.flags.sub16(*d.dst16, d.imm); }
+TITAN_HANDLER(SubRR16) { *d.dst16 = s.flags.sub16(*d.dst16, *d.src16); }
+TITAN_HANDLER(CmpRI16) { s.flags.sub16(*d.dst16, d.imm); }
+TITAN_HANDLER(CmpRR16) { s.flags.sub16(*d.dst16, *d.src16); }
+TITAN_HANDLER(Load16) {
+    *d.dst16 = s.readWord(d.imm);
+    if (s.debug.watching) { s.noteRead(d.imm); s.noteRead((uint16_t)(d.imm + 1)); }
+}
+TITAN_HANDLER(Store16) { s.writeWord(d.imm, *d.src16); }
+TITAN_HANDLER(Int) { s.interrupt((uint8_t)d.imm, debugMode); }
+TITAN_HANDLER(PrintN) { s.printString(d.imm); }
+TITAN_HANDLER(PushImm) { s.push(d.imm); }
+TITAN_HANDLER(PushReg) { s.push(*d.src16); }
+TITAN_HANDLER(Pop) { *d.dst16 = s.pop(); }
+TITAN_HANDLER(PushF) { s.push(s.flags.word() | FLAGS_FIXED); }
+TITAN_HANDLER(PopF) { s.flags.set(s.pop()); }
+TITAN_HANDLER(Call) { s.push(s.IP); s.IP = d.imm; }
+TITAN_HANDLER(Ret) { s.IP = s.pop(); }
+TITAN_HANDLER(Jmp) { s.IP = d.imm; }
+TITAN_HANDLER(Jz) { if (s.flags.zf()) s.IP = d.imm; }
+TITAN_HANDLER(Jnz) { if (!s.flags.zf()) s.IP = d.imm; }
+TITAN_HANDLER(Jcc) { if (s.flags.test(d.opcode & 0x0F)) s.IP = d.imm; }
+TITAN_HANDLER(Mul) { s.regs.word(AX) = s.flags.mul8(s.regs.byte(AL), *d.src); }
+TITAN_HANDLER(Div) { s.divide(*d.src); }
+TITAN_HANDLER(Lea) { *d.dst16 = d.imm; }
+TITAN_HANDLER(Invalid) { s.invalidOpcode(d.opcode); }
+
+const ThreadedEngine::Handler* ThreadedEngine::handlers() {
+    struct Table {
+        Handler h[(int)DecodedOp::Count];
+        Table() {
+            for (auto& e : h) e = &exec<DecodedOp::Invalid>;
+#define TITAN_BIND_HANDLER(op) h[(int)DecodedOp::op] = &exec<DecodedOp::op>;
+            TITAN_HANDLED_OPS(TITAN_BIND_HANDLER)
+#undef TITAN_BIND_HANDLER
+        }
+    };
+    static const Table table;
+    return table.h;
+}
+
+void ThreadedEngine::step(Simulator& s, bool debugMode) {
+    DecodedInstr& d = s.decodeCache[s.IP];
+    if (d.op == DecodedOp::NotDecoded) s.decode(s.IP, d);
+    s.IP = d.nextIP;
+    handlers()[(int)d.op](s, d, debugMode);
+    s.cycles++;
+}
+
+void ThreadedEngine::run(Simulator& s, bool& debugMode, int cycleLimit) {
+    for (;;) {
+        // Debug path: prompt before every instruction, dispatch through the table
+        while (debugMode && s.running && s.cycles < cycleLimit) {
+            if (!s.debugPrompt(debugMode)) return;
+            step(s, debugMode);
+        }
+        if (!s.running || !runFast(s, cycleLimit)) return;
+        debugMode = true; // Breakpoint or watch hit: back to the prompt
+    }
+}
+
+// Ops that can stop the machine (INT, DIV) or touch watched memory. Only
+// after these is the running flag, or a watch hit, checked.
+static constexpr bool canStop(DecodedOp op) {
+    return op == DecodedOp::Int || op == DecodedOp::Div || op == DecodedOp::Store ||
+           op == DecodedOp::Load || op == DecodedOp::Store16 || op == DecodedOp::Load16 || op == DecodedOp::PrintN || op == DecodedOp::PushImm ||
+           op == DecodedOp::PushReg || op == DecodedOp::PushF || op == DecodedOp::Call;
+}
+
+// Non-debug loop. Breakpoints cost one null test per instruction when none
+// are set; returns true when stopped by a breakpoint or watch hit.
+bool ThreadedEngine::runFast(Simulator& s, int cycleLimit) {
+    int cycles = s.cycles;
+    const uint64_t* breakMap = s.debug.points.breakMap();
+    bool paused = false;
+    DecodedInstr* d;
+
+#define TITAN_AT_BREAKPOINT() \
+    (breakMap && ((breakMap[s.IP >> 6] >> (s.IP & 63)) & 1) && s.breakpointHit())
+
+#ifdef TITAN_COMPUTED_GOTO
+    void* labels[(int)DecodedOp::Count];
+    for (auto& l : labels) l = &&op_Invalid;
+#define TITAN_BIND_LABEL(op) labels[(int)DecodedOp::op] = &&op_##op;
+    TITAN_HANDLED_OPS(TITAN_BIND_LABEL)
+#undef TITAN_BIND_LABEL
+
+#define TITAN_DISPATCH() \
+    do { \
+        if (cycles >= cycleLimit) goto done; \
+        if (TITAN_AT_BREAKPOINT()) goto pause; \
+        d = &s.decodeCache[s.IP]; \
+        if (d->op == DecodedOp::NotDecoded) s.decode(s.IP, *d); \
+        s.IP = d->nextIP; \
+        cycles++; \
+        goto *labels[(int)d->op]; \
+    } while (0)
+
+    TITAN_DISPATCH();
+
+#define TITAN_LABEL(op) \
+    op_##op: \
+        exec<DecodedOp::op>(s, *d, false); \
+        if (canStop(DecodedOp::op)) { \
+            if (!s.running) goto done; \
+            if (s.debug.watchHit || s.debug.watchpointHit) goto pause; \
+        } \
+        TITAN_DISPATCH();
+    TITAN_HANDLED_OPS(TITAN_LABEL)
+#undef TITAN_LABEL
+#undef TITAN_DISPATCH
+
+op_Invalid:
+    s.invalidOpcode(d->opcode);
+    goto done;
+pause:
+    paused = true;
+done:
+    s.cycles = cycles;
+#else
+    const Handler* table = handlers();
+    while (cycles < cycleLimit) {
+        if (TITAN_AT_BREAKPOINT()) { paused = true; break; }
+        d = &s.decodeCache[s.IP];
+        if (d->op == DecodedOp::NotDecoded) s.decode(s.IP, *d);
+        s.IP = d->nextIP;
+        cycles++;
+        table[(int)d->op](s, *d, false);
+        if (!s.running) break;
+        if (s.debug.watchHit || s.debug.watchpointHit) { paused = true; break; }
+    }
+    s.cycles = cycles;
+#endif
+#undef TITAN_AT_BREAKPOINT
+    return paused;
+}
@@ -0,0 +1,24 @@
+#ifndef THREADEDENGINE_H
+#define THREADEDENGINE_H
+
+#include "Simulator.h"
+
+// Table-driven execution engine. Every decoded op has its own handler; the
+// non-debug loop threads from handler to handler with computed goto on
+// GCC/Clang and falls back to a function-pointer table elsewhere.
+struct ThreadedEngine {
+    typedef void (*Handler)(Simulator& s, const DecodedInstr& d, bool debugMode);
+
+    // Executes until the machine stops or reaches cycleLimit
+    static void run(Simulator& s, bool& debugMode, int cycleLimit);
+
+private:
+    template <DecodedOp Op>
+    static void exec(Simulator& s, const DecodedInstr& d, bool debugMode);
+
+    static const Handler* handlers();
+    static void step(Simulator& s, bool debugMode);
+    static bool runFast(Simulator& s, int cycleLimit);
+};
+
+#endif
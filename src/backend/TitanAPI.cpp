@@ -0,0 +1,136 @@
+#include "TitanAPI.h"
+#include "Assembler.h"
+#include "Simulator.h"
+#include <climits>
+#include <cstring>
+#include <new>
+
+struct TitanAssembly {
+    bool success;
+    std::string diagnostics;
+    std::string listing;
+    std::vector<uint8_t> image;
+};
+
+struct TitanMachine {
+    Simulator cpu;
+    ScriptedDevice console; // Output kept until read_output drains it
+
+    TitanMachine() {
+        cpu.setDevice(console);
+    }
+};
+
+TitanAssembly* titan_assemble(const char* source, size_t length) {
+    TitanAssembly* assembly = new (std::nothrow) TitanAssembly();
+    if (!assembly) return nullptr;
+
+    Assembler assembler;
+    AssemblyResult result = assembler.assembleSource(std::string(source, length));
+    assembly->success = result.success;
+    for (const Diagnostic& d : result.diagnostics) {
+        assembly->diagnostics += formatDiagnostic(d, "source") + "\n";
+    }
+    if (result.success) {
+        assembly->listing = result.image.listing();
+        result.image.serialize(assembly->image);
+    }
+    return assembly;
+}
+
+int titan_assembly_succeeded(const TitanAssembly* assembly) {
+    return assembly->success ? 1 : 0;
+}
+
+const char* titan_assembly_diagnostics(const TitanAssembly* assembly) {
+    return assembly->diagnostics.c_str();
+}
+
+const char* titan_assembly_listing(const TitanAssembly* assembly) {
+    return assembly->listing.c_str();
+}
+
+const uint8_t* titan_assembly_image(const TitanAssembly* assembly, size_t* size) {
+    *size = assembly->image.size();
+    return assembly->image.data();
+}
+
+void titan_assembly_free(TitanAssembly* assembly) {
+    delete assembly;
+}
+
+TitanMachine* titan_machine_create(void) {
+    return new (std::nothrow) TitanMachine();
+}
+
+void titan_machine_free(TitanMachine* machine) {
+    delete machine;
+}
+
+int titan_machine_load_image(TitanMachine* machine, const uint8_t* image, size_t size) {
+    machine->cpu.reset();
+    machine->console = ScriptedDevice();
+    if (!machine->cpu.loadImage(image, size)) return 0;
+    machine->cpu.start();
+    return 1;
+}
+
+void titan_machine_set_input(TitanMachine* machine, const char* text, size_t length) {
+    machine->console.append(text, length);
+}
+
+void titan_machine_set_limits(TitanMachine* machine, int max_cycles, double max_seconds) {
+    machine->cpu.setCycleLimit(max_cycles);
+    machine->cpu.setTimeLimit(max_seconds);
+}
+
+int titan_machine_step(TitanMachine* machine, int count) {
+    return machine->cpu.step(count);
+}
+
+int titan_machine_run(TitanMachine* machine) {
+    return machine->cpu.step(INT_MAX); // Bounded by the cycle limit
+}
+
+void titan_machine_registers(const TitanMachine* machine, TitanRegisters* out) {
+    const Simulator& cpu = machine->cpu;
+    out->ip = cpu.getIP();
+    out->sp = cpu.getSP();
+    out->ax = cpu.getRegister(AX);
+    out->bx = cpu.getRegister(BX);
+    out->cx = cpu.getRegister(CX);
+    out->dx = cpu.getRegister(DX);
+    out->zf = cpu.getZF() ? 1 : 0;
+    out->running = cpu.isRunning() ? 1 : 0;
+    out->flags = (uint16_t)(cpu.getFlags() | FLAGS_FIXED);
+}
+
+void titan_machine_stats(const TitanMachine* machine, TitanStats* out) {
+    RunStats stats = machine->cpu.stats();
+    out->termination = (int)stats.termination; // Same order as the TITAN_ constants
+    out->instructions = stats.instructions;
+    out->seconds = stats.seconds;
+    out->fault_ip = stats.faultIP;
+    out->fault_opcode = stats.faultOpcode;
+}
+
+const char* titan_termination_name(int termination) {
+    if (termination < 0 || termination > UINT8_MAX) return "unknown";
+    return terminationName((Termination)termination);
+}
+
+size_t titan_machine_read_memory(const TitanMachine* machine, uint16_t address, uint8_t* out, size_t count) {
+    const Simulator& cpu = machine->cpu;
+    size_t available = cpu.memorySize() > address ? cpu.memorySize() - address : 0;
+    if (count > available) count = available;
+    std::memcpy(out, cpu.memoryData() + address, count);
+    return count;
+}
+
+size_t titan_machine_read_output(TitanMachine* machine, char* buffer, size_t capacity) {
+    std::string& output = machine->console.output();
+    size_t n = output.size() < capacity ? output.size() : capacity;
+    std::memcpy(buffer, output.data(), n);
+    output.erase(0, n);
+    return n;
+}
@@ -0,0 +1,98 @@
+#ifndef TITANAPI_H
+#define TITANAPI_H
+
+/*
+ * Stable C interface to the assembler and simulator, for embedding the
+ * backend as a library (e.g. a DLL loaded by the studio). Build the library
+ * from every backend source except main.cpp, defining TITAN_BUILD_DLL when
+ * producing a Windows DLL.
+ *
+ * Handles are not thread-safe; use one TitanMachine per thread. Strings
+ * returned by the library stay valid until the owning handle is freed.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32) && defined(TITAN_BUILD_DLL)
+#define TITAN_API __declspec(dllexport)
+#elif defined(_WIN32) && defined(TITAN_USE_DLL)
+#define TITAN_API __declspec(dllimport)
+#elif defined(__GNUC__)
+#define TITAN_API __attribute__((visibility("default")))
+#else
+#define TITAN_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct TitanAssembly TitanAssembly;
+typedef struct TitanMachine TitanMachine;
+
+typedef struct TitanRegisters {
+    uint16_t ip, sp;
+    uint16_t ax, bx, cx, dx;
+    uint8_t zf;
+    uint8_t running;
+    uint16_t flags;            /* 8086 FLAGS word (CF PF AF ZF SF OF) */
+} TitanRegisters;
+
+/* Why the program stopped */
+enum {
+    TITAN_RUNNING = 0,
+    TITAN_EXIT = 1,            /* INT 21h AH=4Ch */
+    TITAN_CYCLE_LIMIT = 2,
+    TITAN_TIME_LIMIT = 3,
+    TITAN_INVALID_OPCODE = 4,  /* at fault_ip */
+    TITAN_DIVIDE_ERROR = 5,    /* at fault_ip */
+    TITAN_QUIT = 6             /* debug session ended by the user */
+};
+
+typedef struct TitanStats {
+    int termination;
+    int instructions;
+    double seconds;            /* Wall time spent executing */
+    uint16_t fault_ip;
+    uint8_t fault_opcode;
+} TitanStats;
+
+/* Assembly: never returns NULL except on allocation failure */
+TITAN_API TitanAssembly* titan_assemble(const char* source, size_t length);
+TITAN_API int titan_assembly_succeeded(const TitanAssembly* assembly);
+/* "source:line: error: message" lines */
+TITAN_API const char* titan_assembly_diagnostics(const TitanAssembly* assembly);
+/* "ADDR CODE" text listing */
+TITAN_API const char* titan_assembly_listing(const TitanAssembly* assembly);
+/* Serialized binary object image, loadable with titan_machine_load_image */
+TITAN_API const uint8_t* titan_assembly_image(const TitanAssembly* assembly, size_t* size);
+TITAN_API void titan_assembly_free(TitanAssembly* assembly);
+
+/* Machine: console input is queued with set_input, output is drained with read_output */
+TITAN_API TitanMachine* titan_machine_create(void);
+TITAN_API void titan_machine_free(TitanMachine* machine);
+/* Resets the machine, loads the image and readies it to run; returns 0 on a bad image */
+TITAN_API int titan_machine_load_image(TitanMachine* machine, const uint8_t* image, size_t size);
+TITAN_API void titan_machine_set_input(TitanMachine* machine, const char* text, size_t length);
+/* Applies from the next step/run; max_cycles <= 0 or max_seconds <= 0 means no limit.
+   Defaults: 5000 cycles, no time limit. */
+TITAN_API void titan_machine_set_limits(TitanMachine* machine, int max_cycles, double max_seconds);
+/* Executes up to count instructions; returns how many ran */
+TITAN_API int titan_machine_step(TitanMachine* machine, int count);
+/* Runs until the program stops or hits the cycle limit; returns instructions executed */
+TITAN_API int titan_machine_run(TitanMachine* machine);
+TITAN_API void titan_machine_registers(const TitanMachine* machine, TitanRegisters* out);
+TITAN_API void titan_machine_stats(const TitanMachine* machine, TitanStats* out);
+/* "exit", "cycle_limit", ... for a TITAN_ termination; "unknown" for other values */
+TITAN_API const char* titan_termination_name(int termination);
+/* Copies up to count bytes starting at address; returns how many were copied */
+TITAN_API size_t titan_machine_read_memory(const TitanMachine* machine, uint16_t address, uint8_t* out, size_t count);
+/* Moves up to capacity bytes of pending program output into buffer; returns how many */
+TITAN_API size_t titan_machine_read_output(TitanMachine* machine, char* buffer, size_t capacity);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
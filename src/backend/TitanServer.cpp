@@ -0,0 +1,131 @@
+#include "TitanServer.h"
+#include "TitanAPI.h"
+#include "ObjectImage.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <vector>
+
+bool TitanServer::readFrame(std::istream& in, std::string& payload) {
+    unsigned char header[4];
+    if (!in.read((char*)header, 4)) return false;
+    uint32_t length = header[0] | (header[1] << 8) | (header[2] << 16) | ((uint32_t)header[3] << 24);
+    if (length > MAX_FRAME) return false;
+    payload.resize(length);
+    return length == 0 || (bool)in.read(&payload[0], length);
+}
+
+void TitanServer::writeFrame(std::ostream& out, const std::string& status, const std::string& body) {
+    uint32_t length = (uint32_t)(status.size() + 1 + body.size());
+    unsigned char header[4] = { (unsigned char)length, (unsigned char)(length >> 8),
+                                (unsigned char)(length >> 16), (unsigned char)(length >> 24) };
+    out.write((const char*)header, 4);
+    out << status << '\n' << body;
+    out.flush();
+}
+
+int TitanServer::serve(std::istream& in, std::ostream& out) {
+    TitanMachine* machine = titan_machine_create();
+    TitanAssembly* assembly = nullptr;
+    if (!machine) return 1;
+
+    // Program output since the last response
+    auto drainOutput = [&]() {
+        std::string text;
+        char buf[4096];
+        size_t n;
+        while ((n = titan_machine_read_output(machine, buf, sizeof(buf))) > 0) text.append(buf, n);
+        return text;
+    };
+
+    std::string payload;
+    while (readFrame(in, payload)) {
+        size_t eol = payload.find('\n');
+        std::string commandLine = payload.substr(0, eol);
+        std::string body = eol == std::string::npos ? std::string() : payload.substr(eol + 1);
+        std::istringstream args(commandLine);
+        std::string command;
+        args >> command;
+
+        if (command == "assemble") {
+            if (assembly) titan_assembly_free(assembly);
+            assembly = titan_assemble(body.data(), body.size());
+            writeFrame(out, titan_assembly_succeeded(assembly) ? "ok" : "failed", titan_assembly_diagnostics(assembly));
+        } else if (command == "listing") {
+            if (!assembly) writeFrame(out, "error nothing assembled", "");
+            else writeFrame(out, "ok", titan_assembly_listing(assembly));
+        } else if (command == "save") {
+            std::string path;
+            std::getline(args >> std::ws, path);
+            size_t size = 0;
+            const uint8_t* image = assembly ? titan_assembly_image(assembly, &size) : nullptr;
+            FILE* f = size ? std::fopen(path.c_str(), "wb") : nullptr;
+            bool ok = f && std::fwrite(image, 1, size, f) == size;
+            if (f && std::fclose(f) != 0) ok = false;
+            writeFrame(out, ok ? "ok" : "error could not save image", "");
+        } else if (command == "load") {
+            std::string path;
+            std::getline(args >> std::ws, path);
+            bool ok = false;
+            if (path.empty()) {
+                size_t size = 0;
+                const uint8_t* image = assembly ? titan_assembly_image(assembly, &size) : nullptr;
+                ok = size && titan_machine_load_image(machine, image, size);
+            } else {
+                MappedFile mapped;
+                ok = mapped.open(path) && titan_machine_load_image(machine, mapped.data(), mapped.size());
+            }
+            writeFrame(out, ok ? "ok" : "error could not load image", "");
+        } else if (command == "input") {
+            titan_machine_set_input(machine, body.data(), body.size());
+            writeFrame(out, "ok", "");
+        } else if (command == "limits") {
+            int cycles = 0;
+            double ms = 0;
+            args >> cycles >> ms;
+            titan_machine_set_limits(machine, cycles, ms / 1000);
+            writeFrame(out, "ok", "");
+        } else if (command == "step") {
+            int count = 1;
+            args >> count;
+            titan_machine_step(machine, count);
+            writeFrame(out, "ok", drainOutput());
+        } else if (command == "run") {
+            titan_machine_run(machine);
+            writeFrame(out, "ok", drainOutput());
+        } else if (command == "regs") {
+            TitanRegisters r;
+            titan_machine_registers(machine, &r);
+            char buf[64];
+            std::snprintf(buf, sizeof(buf), "%04x|%04x|%04x|%04x|%04x|%04x|%d|%d|%04x",
+                          r.ip, r.ax, r.bx, r.cx, r.dx, r.sp, r.zf, r.running, r.flags);
+            writeFrame(out, "ok", buf);
+        } else if (command == "stats") {
+            TitanStats st;
+            titan_machine_stats(machine, &st);
+            char buf[96];
+            std::snprintf(buf, sizeof(buf), "%s|%d|%.3f|%04x|%02x", titan_termination_name(st.termination), st.instructions,
+                          st.seconds * 1000, st.fault_ip, st.fault_opcode);
+            writeFrame(out, "ok", buf);
+        } else if (command == "memory") {
+            std::string addr;
+            size_t count = 0;
+            args >> addr >> count;
+            uint16_t address = (uint16_t)std::strtoul(addr.c_str(), nullptr, 16);
+            if (count > 65536u - address) count = 65536u - address;
+            std::vector<uint8_t> bytes(count);
+            count = titan_machine_read_memory(machine, address, bytes.data(), count);
+            writeFrame(out, "ok", std::string((const char*)bytes.data(), count));
+        } else if (command == "quit") {
+            writeFrame(out, "ok", "");
+            break;
+        } else {
+            writeFrame(out, "error unknown command '" + command + "'", "");
+        }
+    }
+
+    if (assembly) titan_assembly_free(assembly);
+    titan_machine_free(machine);
+    return 0;
+}
@@ -0,0 +1,37 @@
+#ifndef TITANSERVER_H
+#define TITANSERVER_H
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+// Long-lived backend for the studio ("-serve"). Requests and responses are
+// frames: a u32 little-endian payload length followed by the payload.
+//   Request  : "<command> [args]\n<body>"
+//   Response : "ok|failed|error [message]\n<body>"
+// Commands:
+//   assemble          body is the source; response body holds diagnostics
+//   listing           "ADDR CODE" listing of the last assembly
+//   save <path>       write the last assembly's binary image
+//   load [path]       load the last assembly, or an object file, and reset
+//   input             queue body as console input
+//   limits <cycles> <ms>  cycle and wall-clock limits, 0 = none
+//   step <n> | run    execute; response body is the program output produced
+//   regs              "IP|AX|BX|CX|DX|SP|ZF|RUNNING|FLAGS" in hex
+//   stats             "termination|instructions|ms|faultIP|faultOpcode"
+//   memory <addr> <n> raw bytes, addr in hex
+//   quit
+// All work goes through the C API in TitanAPI.h. A request longer than
+// MAX_FRAME ends the session.
+class TitanServer {
+private:
+    static const uint32_t MAX_FRAME = 16 << 20;
+
+    static bool readFrame(std::istream& in, std::string& payload);
+    static void writeFrame(std::ostream& out, const std::string& status, const std::string& body);
+
+public:
+    static int serve(std::istream& in, std::ostream& out);
+};
+
+#endif
@@ -0,0 +1,226 @@
+#include "Tracer.h"
+#include <cstdio>
+
+static const char TRACE_MAGIC[4] = { 'T', 'T', 'R', 'C' };
+static const size_t TRACE_HEADER_SIZE = 22;
+
+enum : uint8_t {
+    KIND_SP = 1 << 4,
+    KIND_FLAGS = 1 << 5,
+    KIND_WRITE = 1 << 7,
+    KIND_ALL_REGS = 0x1F
+};
+
+static void put16(std::vector<uint8_t>& out, uint16_t v) {
+    out.push_back(v & 0xFF);
+    out.push_back(v >> 8);
+}
+
+static uint16_t get16(const uint8_t* p) { return p[0] | (p[1] << 8); }
+
+static const char* mnemonic(uint8_t opcode) {
+    switch (opcode) {
+        case 0x01: case 0x02: case 0x05: case 0x06: return "mov";
+        case 0x81: case 0x82: case 0x85: case 0x86: return "mov";
+        case 0x03: case 0x83: return "add";
+        case 0x04: case 0x84: return "sub";
+        case 0x07: case 0x87: return "cmp";
+        case 0x10: return "int";
+        case 0x15: return "lea";
+        case 0x20: return "printn";
+        case 0x30: return "push";
+        case 0x31: return "pop";
+        case 0x32: return "call";
+        case 0x33: return "ret";
+        case 0x34: return "pushf";
+        case 0x35: return "popf";
+        case 0x40: return "jmp";
+        case 0x41: return "jz";
+        case 0x42: return "jnz";
+        case 0x50: return "mul";
+        case 0x51: return "div";
+        case JCC_BASE + 0x0: return "jo";
+        case JCC_BASE + 0x1: return "jno";
+        case JCC_BASE + 0x2: return "jc";
+        case JCC_BASE + 0x3: return "jnc";
+        case JCC_BASE + 0x4: return "je";
+        case JCC_BASE + 0x5: return "jne";
+        case JCC_BASE + 0x6: return "jbe";
+        case JCC_BASE + 0x7: return "ja";
+        case JCC_BASE + 0x8: return "js";
+        case JCC_BASE + 0x9: return "jns";
+        case JCC_BASE + 0xA: return "jp";
+        case JCC_BASE + 0xB: return "jnp";
+        case JCC_BASE + 0xC: return "jl";
+        case JCC_BASE + 0xD: return "jge";
+        case JCC_BASE + 0xE: return "jle";
+        case JCC_BASE + 0xF: return "jg";
+        default: return "?";
+    }
+}
+
+Tracer::Tracer(size_t capacity) : retired(0) {
+    size_t size = 2;
+    while (size < capacity + 1) size <<= 1; // One slot is the entry being filled
+    ring.resize(size);
+    mask = size - 1;
+}
+
+void Tracer::clear() {
+    retired = 0;
+}
+
+std::vector<TraceEntry> Tracer::last(size_t n) const {
+    uint64_t end = retired;
+    uint64_t first = end > capacity() ? end - capacity() : 0;
+    if (end - first > n) first = end - n;
+
+    std::vector<TraceEntry> entries;
+    entries.reserve((size_t)(end - first));
+    for (uint64_t i = first; i < end; i++) entries.push_back(ring[i & mask]);
+    return entries;
+}
+
+void Tracer::serialize(std::vector<uint8_t>& out, const RunStats& stats, size_t n) const {
+    std::vector<TraceEntry> entries = last(n ? n : capacity());
+    uint64_t total = count();
+
+    out.clear();
+    out.reserve(TRACE_HEADER_SIZE + entries.size() * 8);
+    out.insert(out.end(), TRACE_MAGIC, TRACE_MAGIC + 4);
+    put16(out, VERSION);
+    out.push_back((uint8_t)stats.termination);
+    out.push_back(stats.faultOpcode);
+    put16(out, stats.faultIP);
+    for (int i = 0; i < 8; i++) out.push_back((uint8_t)(total >> (8 * i)));
+    uint32_t entryCount = (uint32_t)entries.size();
+    put16(out, (uint16_t)(entryCount & 0xFFFF));
+    put16(out, (uint16_t)(entryCount >> 16));
+
+    const TraceEntry* prev = nullptr;
+    for (const TraceEntry& e : entries) {
+        uint8_t kind = prev ? 0 : KIND_ALL_REGS | KIND_FLAGS;
+        for (int r = 0; r < 4 && prev; r++) {
+            if (e.regs[r] != prev->regs[r]) kind |= 1 << r;
+        }
+        if (prev && e.sp != prev->sp) kind |= KIND_SP;
+        if (prev && e.flags != prev->flags) kind |= KIND_FLAGS;
+        if (e.writes) kind |= KIND_WRITE;
+
+        put16(out, e.ip);
+        out.push_back(e.opcode);
+        out.push_back(kind);
+        for (int r = 0; r < 4; r++) {
+            if (kind & (1 << r)) put16(out, e.regs[r]);
+        }
+        if (kind & KIND_SP) put16(out, e.sp);
+        if (kind & KIND_FLAGS) put16(out, e.flags);
+        if (kind & KIND_WRITE) {
+            put16(out, e.writeAddr);
+            out.push_back(e.writes);
+            out.insert(out.end(), e.written, e.written + e.writes);
+        }
+        prev = &e;
+    }
+}
+
+bool Tracer::dump(const std::string& path, const RunStats& stats, size_t n) const {
+    std::vector<uint8_t> buf;
+    serialize(buf, stats, n);
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) return false;
+    bool ok = std::fwrite(buf.data(), 1, buf.size(), f) == buf.size();
+    return (std::fclose(f) == 0) && ok;
+}
+
+bool Tracer::parse(const uint8_t* data, size_t size, TraceFile& trace) {
+    if (size < TRACE_HEADER_SIZE || std::char_traits<char>::compare((const char*)data, TRACE_MAGIC, 4) != 0) return false;
+    if (get16(data + 4) != VERSION) return false;
+    trace.termination = (Termination)data[6];
+    trace.faultOpcode = data[7];
+    trace.faultIP = get16(data + 8);
+    trace.retired = 0;
+    for (int i = 0; i < 8; i++) trace.retired |= (uint64_t)data[10 + i] << (8 * i);
+    uint32_t count = get16(data + 18) | ((uint32_t)get16(data + 20) << 16);
+
+    trace.entries.clear();
+    trace.entries.reserve(count < size ? count : size); // Entries take at least 4 bytes
+    TraceEntry e{};
+    size_t pos = TRACE_HEADER_SIZE;
+    for (uint32_t i = 0; i < count; i++) {
+        if (pos + 4 > size) return false;
+        e.ip = get16(data + pos);
+        e.opcode = data[pos + 2];
+        uint8_t kind = data[pos + 3];
+        pos += 4;
+        if (i == 0 && (kind & (KIND_ALL_REGS | KIND_FLAGS)) != (KIND_ALL_REGS | KIND_FLAGS)) return false;
+        for (int r = 0; r < 4; r++) {
+            if (!(kind & (1 << r))) continue;
+            if (pos + 2 > size) return false;
+            e.regs[r] = get16(data + pos);
+            pos += 2;
+        }
+        if (kind & KIND_SP) {
+            if (pos + 2 > size) return false;
+            e.sp = get16(data + pos);
+            pos += 2;
+        }
+        if (kind & KIND_FLAGS) {
+            if (pos + 2 > size) return false;
+            e.flags = get16(data + pos);
+            pos += 2;
+        }
+        e.writes = 0;
+        if (kind & KIND_WRITE) {
+            if (pos + 3 > size || data[pos + 2] < 1 || data[pos + 2] > 2 || pos + 3 + data[pos + 2] > size) return false;
+            e.writeAddr = get16(data + pos);
+            e.writes = data[pos + 2];
+            for (int k = 0; k < e.writes; k++) e.written[k] = data[pos + 3 + k];
+            pos += 3 + e.writes;
+        }
+        trace.entries.push_back(e);
+    }
+    return pos == size;
+}
+
+void Tracer::print(std::ostream& out, const TraceFile& trace, const ObjectImage& image, const std::string& mainFile) {
+    static const char* const REG_NAMES[4] = { "AX", "BX", "CX", "DX" };
+    char buf[64];
+
+    out << "--- Trace: last " << trace.entries.size() << " of " << trace.retired << " instructions, "
+        << terminationName(trace.termination);
+    if (trace.termination == Termination::InvalidOpcode || trace.termination == Termination::DivideError) {
+        std::snprintf(buf, sizeof(buf), " at %04X (opcode %02X)", trace.faultIP, trace.faultOpcode);
+        out << buf;
+    }
+    out << " ---\n";
+
+    uint64_t number = trace.retired - trace.entries.size();
+    const TraceEntry* prev = nullptr;
+    for (const TraceEntry& e : trace.entries) {
+        std::snprintf(buf, sizeof(buf), "%10llu  %04X  %02X %-6s ", (unsigned long long)number++, e.ip, e.opcode, mnemonic(e.opcode));
+        out << buf;
+        for (int r = 0; r < 4; r++) {
+            if (prev && e.regs[r] == prev->regs[r]) continue;
+            std::snprintf(buf, sizeof(buf), " %s=%04X", REG_NAMES[r], e.regs[r]);
+            out << buf;
+        }
+        if (!prev || e.sp != prev->sp) {
+            std::snprintf(buf, sizeof(buf), " SP=%04X", e.sp);
+            out << buf;
+        }
+        if (!prev || e.flags != prev->flags) {
+            std::snprintf(buf, sizeof(buf), " FLAGS=%04X", e.flags | FLAGS_FIXED);
+            out << buf;
+        }
+        for (int k = 0; k < e.writes; k++) {
+            std::snprintf(buf, sizeof(buf), " [%04X]=%02X", (uint16_t)(e.writeAddr + k), e.written[k]);
+            out << buf;
+        }
+        std::string where = image.describe(e.ip, mainFile);
+        if (!where.empty()) out << "  ; " << where;
+        out << "\n";
+        prev = &e;
+    }
+    out << std::flush;
+}
@@ -0,0 +1,96 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Simulator.h"
+#include "ObjectImage.h"
+
+// One retired instruction: where it ran, its opcode byte, the memory it
+// wrote and the registers after it
+struct TraceEntry {
+    uint16_t ip;
+    uint8_t opcode;
+    uint8_t writes;      // Bytes written to memory from writeAddr on, at most 2
+    uint16_t writeAddr;
+    uint8_t written[2];
+    uint16_t regs[4];    // AX, BX, CX, DX
+    uint16_t sp;
+    uint16_t flags;      // Status flags (FLAG_STATUS bits)
+};
+
+// Header of a dumped trace and its entries, oldest first
+struct TraceFile {
+    Termination termination;
+    uint16_t faultIP;
+    uint8_t faultOpcode;
+    uint64_t retired;    // Instructions traced in the whole run
+    std::vector<TraceEntry> entries;
+};
+
+// The last capacity() retired instructions in a ring buffer. Attached with
+// Simulator::setTracer(); the simulator then runs on the switch engine and
+// fills one fixed-size entry per instruction, with no I/O until dump().
+// Not thread-safe: read it from the simulator's thread between runs.
+//
+// Dump format, little-endian:
+//   Header : "TTRC", u16 version, u8 termination, u8 faultOpcode, u16 faultIP,
+//            u64 retired, u32 entryCount
+//   Entry  : u16 ip, u8 opcode, u8 kind, then in order
+//            u16 for each changed register (kind bits 0-3: AX..DX, bit 4: SP),
+//            u16 FLAGS if the status flags changed (bit 5),
+//            u16 address, u8 count, <count> bytes if memory was written (bit 7)
+//            Bit 6 is unused. The first entry lists every register and FLAGS.
+class Tracer {
+private:
+    std::vector<TraceEntry> ring;
+    size_t mask;
+    uint64_t retired; // Entries complete; the next one is filled at retired & mask
+
+public:
+    static const uint16_t VERSION = 2;
+
+    // Holds at least capacity entries; the ring is a power of two
+    explicit Tracer(size_t capacity = 4096);
+    void clear();
+
+    size_t capacity() const { return ring.size() - 1; }
+    uint64_t count() const { return retired; }
+
+    // Simulator side: begin() before the instruction, noteWrite() for each
+    // byte it stores, end() after it
+    void begin(uint16_t ip, uint8_t opcode) {
+        TraceEntry& e = ring[retired & mask];
+        e.ip = ip;
+        e.opcode = opcode;
+        e.writes = 0;
+    }
+    void noteWrite(uint16_t addr, uint8_t value) {
+        TraceEntry& e = ring[retired & mask];
+        if (e.writes == 0) e.writeAddr = addr;
+        if (e.writes < 2) e.written[e.writes++] = value;
+    }
+    void end(const RegisterFile& regs, uint16_t sp, uint16_t flags) {
+        TraceEntry& e = ring[retired & mask];
+        for (int r = 0; r < 4; r++) e.regs[r] = regs.w[r];
+        e.sp = sp;
+        e.flags = flags;
+        retired++;
+    }
+
+    // Up to n of the newest entries, oldest first
+    std::vector<TraceEntry> last(size_t n) const;
+
+    // The newest n entries (all when n is 0) with the run's outcome
+    void serialize(std::vector<uint8_t>& out, const RunStats& stats, size_t n = 0) const;
+    bool dump(const std::string& path, const RunStats& stats, size_t n = 0) const;
+
+    static bool parse(const uint8_t* data, size_t size, TraceFile& trace);
+    // One line per entry: instruction number, address, opcode, source
+    // position from image, then changed registers, FLAGS and memory writes
+    static void print(std::ostream& out, const TraceFile& trace, const ObjectImage& image, const std::string& mainFile);
+};
+
+#endif
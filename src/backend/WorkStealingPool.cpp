@@ -0,0 +1,59 @@
+#include "WorkStealingPool.h"
+#include <thread>
+
+WorkStealingPool::WorkStealingPool(unsigned threads) {
+    threadCount = threads ? threads : std::thread::hardware_concurrency();
+    if (threadCount == 0) threadCount = 1;
+}
+
+bool WorkStealingPool::popBack(Queue& q, size_t& item) {
+    std::lock_guard<std::mutex> guard(q.lock);
+    if (q.items.empty()) return false;
+    item = q.items.back();
+    q.items.pop_back();
+    return true;
+}
+
+bool WorkStealingPool::popFront(Queue& q, size_t& item) {
+    std::lock_guard<std::mutex> guard(q.lock);
+    if (q.items.empty()) return false;
+    item = q.items.front();
+    q.items.pop_front();
+    return true;
+}
+
+void WorkStealingPool::run(size_t count, const std::function<void(size_t)>& job) {
+    if (count == 0) return;
+    size_t workers = threadCount < count ? threadCount : count;
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    for (size_t w = 0; w < workers; w++) {
+        queues.push_back(std::make_unique<Queue>());
+        // Own block is taken from the back, so push it reversed to run in order
+        for (size_t i = (w + 1) * count / workers; i > w * count / workers; i--) {
+            queues[w]->items.push_back(i - 1);
+        }
+    }
+
+    // No job adds work, so a worker is done once every deque is empty
+    auto worker = [&](size_t self) {
+        size_t item;
+        for (;;) {
+            if (popBack(*queues[self], item)) {
+                job(item);
+                continue;
+            }
+            bool stole = false;
+            for (size_t k = 1; k < workers && !stole; k++) {
+                stole = popFront(*queues[(self + k) % workers], item);
+            }
+            if (!stole) return;
+            job(item);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t w = 1; w < workers; w++) threads.emplace_back(worker, w);
+    worker(0);
+    for (std::thread& t : threads) t.join();
+}
@@ -0,0 +1,38 @@
+#ifndef WORKSTEALINGPOOL_H
+#define WORKSTEALINGPOOL_H
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Runs a fixed set of jobs, identified by index, across worker threads.
+// Every worker starts with a contiguous block of indices and takes from the
+// back of its own deque; once that is empty it steals from the front of the
+// others, so a few slow jobs do not leave the remaining cores idle.
+class WorkStealingPool {
+private:
+    struct Queue {
+        std::mutex lock;
+        std::deque<size_t> items;
+    };
+
+    unsigned threadCount;
+
+    static bool popBack(Queue& q, size_t& item);
+    static bool popFront(Queue& q, size_t& item);
+
+public:
+    // threads == 0 uses one worker per hardware thread
+    explicit WorkStealingPool(unsigned threads = 0);
+
+    unsigned threads() const { return threadCount; }
+
+    // Calls job(i) once for every i in [0, count) and returns when all are done.
+    // job runs concurrently on several threads and must not throw.
+    void run(size_t count, const std::function<void(size_t)>& job);
+};
+
+#endif
@@ -1,15 +1,159 @@
 #include "Assembler.h"
 #include "Simulator.h"
+#include "BatchRunner.h"
+#include "TitanServer.h"
+#include "ObjectImage.h"
+#include "Profiler.h"
+#include "Tracer.h"
 #include <iostream>
+#include <fstream>
+#include <cctype>
+#include <cstdio>
 #include <cstring>
+#include <cstdlib>
+#include <memory>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+static bool parseEngine(const std::string& name, Engine& engine) {
+    if (name == "threaded") engine = Engine::Threaded;
+    else if (name == "block") engine = Engine::Block;
+    else if (name == "jit") engine = Engine::Jit;
+    else if (name == "switch") engine = Engine::Switch;
+    else {
+        std::cout << "Error: Unknown engine '" << name << "'." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static void printStats(const RunStats& stats) {
+    char line[128];
+    switch (stats.termination) {
+        case Termination::Exit: std::snprintf(line, sizeof(line), "Stopped: program exit (INT 21h/4Ch)"); break;
+        case Termination::CycleLimit: std::snprintf(line, sizeof(line), "Stopped: cycle limit reached"); break;
+        case Termination::TimeLimit: std::snprintf(line, sizeof(line), "Stopped: time limit reached"); break;
+        case Termination::InvalidOpcode:
+            std::snprintf(line, sizeof(line), "Stopped: invalid opcode %02X at %04X", stats.faultOpcode, stats.faultIP);
+            break;
+        case Termination::DivideError: std::snprintf(line, sizeof(line), "Stopped: divide error at %04X", stats.faultIP); break;
+        default: std::snprintf(line, sizeof(line), "Stopped: %s", terminationName(stats.termination)); break;
+    }
+    std::cout << line << std::endl;
+    std::snprintf(line, sizeof(line), "Instructions: %d, time: %.3f ms, %.2f MIPS",
+                  stats.instructions, stats.seconds * 1000, stats.mips());
+    std::cout << line << std::endl;
+}
+
+static bool isSource(const std::string& path) {
+    size_t dot = path.rfind('.');
+    if (dot == std::string::npos) return false;
+    std::string ext = path.substr(dot);
+    for (char& c : ext) c = (char)std::tolower((unsigned char)c);
+    return ext == ".asm";
+}
+
+// Image with symbols and line table: assembled from a source, else read
+// from an object file
+static bool readImage(const std::string& path, ObjectImage& image) {
+    MappedFile file;
+    if (!file.open(path)) return false;
+    if (!isSource(path)) return ObjectImage::parse(file.data(), file.size(), image);
+    Assembler assembler;
+    AssemblyResult result = assembler.assembleSource(std::string((const char*)file.data(), file.size()), path);
+    image = std::move(result.image);
+    return result.success;
+}
 
 int main(int argc, char* argv[]) {
     if (argc < 2) {
-        std::cout << "Usage: assembler <input_file> [output_file]" << std::endl;
-        std::cout << "Usage: assembler -run <object_file>" << std::endl;
+        std::cout << "Usage: assembler <input_file> [output_file] [-listing <listing_file>]" << std::endl;
+        std::cout << "Usage: assembler -run <object_file> [-engine switch|threaded|block|jit] [-cycles N] [-timeout <ms>] [-input <file> | -replay <log>] [-record <log>] [-profile] [-trace <file> [-trace-size N]]" << std::endl;
+        std::cout << "       -run also accepts a .asm source, assembled in memory" << std::endl;
+        std::cout << "Usage: assembler -batch <directory|manifest> [-results <file>] [-jobs N] [-engine switch|threaded|block|jit] [-cycles N] [-timeout <ms>] [-trace-dir <dir> [-trace-size N]]" << std::endl;
+        std::cout << "Usage: assembler -trace-dump <trace_file> [object_file|source]" << std::endl;
+        std::cout << "       -cycles 0 removes the cycle limit (default 5000)" << std::endl;
+        std::cout << "Usage: assembler -serve   (length-prefixed requests on stdin/stdout)" << std::endl;
         return 1;
     }
 
+    // Server Mode: one process answers the studio's requests
+    if (strcmp(argv[1], "-serve") == 0) {
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        std::ios::sync_with_stdio(false);
+        return TitanServer::serve(std::cin, std::cout);
+    }
+
+    // Trace Mode: print a trace written by -run -trace or -batch -trace-dir
+    if (strcmp(argv[1], "-trace-dump") == 0) {
+        if (argc < 3) {
+            std::cout << "Error: Please specify a trace file." << std::endl;
+            return 1;
+        }
+        MappedFile file;
+        TraceFile trace;
+        if (!file.open(argv[2]) || !Tracer::parse(file.data(), file.size(), trace)) {
+            std::cerr << "Error: Could not read trace " << argv[2] << std::endl;
+            return 1;
+        }
+        ObjectImage image;
+        std::string program = argc > 3 ? argv[3] : "";
+        if (!program.empty() && !readImage(program, image)) {
+            std::cerr << "Warning: No symbols from " << program << std::endl;
+        }
+        Tracer::print(std::cout, trace, image, program);
+        return 0;
+    }
+
+    // Batch Mode: assemble and run many sources in-process
+    if (strcmp(argv[1], "-batch") == 0) {
+        if (argc < 3) {
+            std::cout << "Error: Please specify a directory or manifest." << std::endl;
+            return 1;
+        }
+        std::string resultsFile = "results.jsonl";
+        unsigned jobs = 0;
+        Engine engine = Engine::Switch;
+        int cycleLimit = 5000;
+        double timeout = 0;
+        std::string traceDir;
+        size_t traceSize = 4096;
+        for (int i = 3; i < argc; i++) {
+            if (strcmp(argv[i], "-results") == 0 && i + 1 < argc) resultsFile = argv[++i];
+            else if (strcmp(argv[i], "-jobs") == 0 && i + 1 < argc) jobs = (unsigned)std::atoi(argv[++i]);
+            else if (strcmp(argv[i], "-cycles") == 0 && i + 1 < argc) cycleLimit = std::atoi(argv[++i]);
+            else if (strcmp(argv[i], "-timeout") == 0 && i + 1 < argc) timeout = std::atof(argv[++i]) / 1000;
+            else if (strcmp(argv[i], "-trace-dir") == 0 && i + 1 < argc) traceDir = argv[++i];
+            else if (strcmp(argv[i], "-trace-size") == 0 && i + 1 < argc) traceSize = (size_t)std::atol(argv[++i]);
+            else if (strcmp(argv[i], "-engine") == 0 && i + 1 < argc) {
+                if (!parseEngine(argv[++i], engine)) return 1;
+            }
+        }
+
+        std::vector<std::string> files;
+        if (!BatchRunner::collect(argv[2], files)) {
+            std::cerr << "Error: Could not read " << argv[2] << std::endl;
+            return 1;
+        }
+        BatchRunner runner(engine, jobs);
+        runner.setLimits(cycleLimit, timeout);
+        if (!traceDir.empty()) runner.setTrace(traceSize, traceDir);
+        std::vector<BatchResult> results = runner.run(files);
+        if (!BatchRunner::writeResults(resultsFile, results)) {
+            std::cerr << "Error: Could not write " << resultsFile << std::endl;
+            return 1;
+        }
+        size_t ok = 0;
+        for (const BatchResult& r : results) ok += (r.status == "ok");
+        std::cout << ok << "/" << results.size() << " programs ran to completion. Results written to: " << resultsFile << std::endl;
+        return 0;
+    }
+
     // Check for Simulator Mode
     if (strcmp(argv[1], "-run") == 0 || strcmp(argv[1], "-debug") == 0) {
         if (argc < 3) {
@@ -17,10 +161,112 @@ int main(int argc, char* argv[]) {
             return 1;
         }
         std::string objFile = argv[2];
+        std::string inputFile, recordFile, replayFile, traceFile;
+        size_t traceSize = 4096;
+        bool profile = false;
+        Engine engine = Engine::Switch;
         Simulator cpu;
+        for (int i = 3; i < argc; i++) {
+            if (strcmp(argv[i], "-engine") == 0 && i + 1 < argc) {
+                if (!parseEngine(argv[++i], engine)) return 1;
+            }
+            else if (strcmp(argv[i], "-cycles") == 0 && i + 1 < argc) cpu.setCycleLimit(std::atoi(argv[++i]));
+            else if (strcmp(argv[i], "-timeout") == 0 && i + 1 < argc) cpu.setTimeLimit(std::atof(argv[++i]) / 1000);
+            else if (strcmp(argv[i], "-input") == 0 && i + 1 < argc) inputFile = argv[++i];
+            else if (strcmp(argv[i], "-record") == 0 && i + 1 < argc) recordFile = argv[++i];
+            else if (strcmp(argv[i], "-replay") == 0 && i + 1 < argc) replayFile = argv[++i];
+            else if (strcmp(argv[i], "-profile") == 0) profile = true;
+            else if (strcmp(argv[i], "-trace") == 0 && i + 1 < argc) traceFile = argv[++i];
+            else if (strcmp(argv[i], "-trace-size") == 0 && i + 1 < argc) traceSize = (size_t)std::atol(argv[++i]);
+        }
         bool debugMode = (strcmp(argv[1], "-debug") == 0); // Determine if debug mode
-        if (cpu.load(objFile)) {
-            cpu.run(debugMode); // Pass debugMode to run
+        bool interactive = inputFile.empty() && replayFile.empty();
+
+        // Program I/O: the terminal, an input file or a recorded run
+        std::unique_ptr<IODevice> device;
+        ReplayDevice* replay = nullptr;
+        if (!replayFile.empty()) {
+            MappedFile log;
+            replay = new ReplayDevice(&std::cout);
+            device.reset(replay);
+            if (!log.open(replayFile) || !replay->load(log.data(), log.size())) {
+                std::cerr << "Error: Could not read recording " << replayFile << std::endl;
+                return 1;
+            }
+        } else if (!inputFile.empty()) {
+            MappedFile script;
+            if (!script.open(inputFile)) {
+                std::cerr << "Error: Could not read " << inputFile << std::endl;
+                return 1;
+            }
+            device.reset(new ScriptedDevice(std::string((const char*)script.data(), script.size()), &std::cout));
+        } else {
+            device.reset(new ConsoleDevice(std::cin, std::cout));
+        }
+        std::ofstream logFile;
+        std::unique_ptr<RecordingDevice> recorder;
+        if (!recordFile.empty()) {
+            logFile.open(recordFile, std::ios::binary);
+            if (!logFile.is_open()) {
+                std::cerr << "Error: Could not write " << recordFile << std::endl;
+                return 1;
+            }
+            recorder.reset(new RecordingDevice(*device, logFile));
+        }
+        cpu.setDevice(recorder ? (IODevice&)*recorder : *device);
+
+        // Sources are assembled in memory; the image also names addresses in the
+        // profile and for the debugger
+        ObjectImage image;
+        bool loaded = false;
+        if (isSource(objFile)) {
+            MappedFile source;
+            if (source.open(objFile)) {
+                Assembler assembler;
+                AssemblyResult result = assembler.assembleSource(std::string((const char*)source.data(), source.size()), objFile);
+                for (const Diagnostic& d : result.diagnostics) std::cerr << formatDiagnostic(d, objFile) << std::endl;
+                loaded = result.success && cpu.loadImage(result.image);
+                image = std::move(result.image);
+            }
+        } else {
+            loaded = cpu.load(objFile);
+            MappedFile object;
+            if (loaded && (profile || debugMode) && object.open(objFile)) ObjectImage::parse(object.data(), object.size(), image);
+        }
+        Profiler profiler;
+        if (profile) cpu.setProfiler(&profiler);
+        std::unique_ptr<Tracer> tracer;
+        if (!traceFile.empty()) {
+            tracer.reset(new Tracer(traceSize ? traceSize : 1));
+            cpu.setTracer(tracer.get());
+        }
+        cpu.setDebugInfo(&image);
+
+        if (loaded) {
+            if (!debugMode) std::cout << "--- TitanASM Simulation Started (IP=0100) ---" << std::endl;
+            cpu.run(debugMode, engine); // Pass debugMode to run
+            if (recorder && !recorder->finish()) {
+                std::cerr << "Error: Could not write " << recordFile << std::endl;
+                return 1;
+            }
+            if (tracer && !tracer->dump(traceFile, cpu.stats(), traceSize)) {
+                std::cerr << "Error: Could not write " << traceFile << std::endl;
+                return 1;
+            }
+            if (!debugMode) {
+                std::cout << "\n--- Simulation Finished ---" << std::endl;
+                printStats(cpu.stats());
+                if (profile) profiler.report(std::cout, image, objFile);
+                if (interactive) {
+                    std::cout << "Press Enter to exit..." << std::endl;
+                    std::cin.ignore();
+                    std::cin.get();
+                }
+            }
+            if (replay && !replay->matches()) {
+                std::cerr << "Error: Replay diverged from the recording." << std::endl;
+                return 1;
+            }
         } else {
             std::cout << "Simulation failed to load." << std::endl;
         }
@@ -30,16 +276,18 @@ int main(int argc, char* argv[]) {
     // Assembler Mode
     std::string inputFile = argv[1];
     std::string outputFile = "output.obj";
+    std::string listingFile;
 
-    if (argc >= 3) {
-        outputFile = argv[2];
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "-listing") == 0 && i + 1 < argc) listingFile = argv[++i];
+        else outputFile = argv[i];
     }
 
     Assembler myAssembler;
     
     std::cout << "Assembler started for file: " << inputFile << std::endl;
     
-    if (myAssembler.assemble(inputFile, outputFile)) {
+    if (myAssembler.assemble(inputFile, outputFile, listingFile)) {
         std::cout << "Assembly completed successfully!" << std::endl;
         std::cout << "Output written to: " << outputFile << std::endl;
     } else {
@@ -3,8 +3,60 @@ using System.Drawing;
 using System.Windows.Forms;
 using System.Diagnostics;
 using System.IO;
+using System.Text;
 using System.Text.RegularExpressions;
 
+// Long-lived backend ("TitanASM.exe -serve"). Each request and response is a
+// length-prefixed frame, so one process serves every assemble.
+public class BackendServer : IDisposable
+{
+    private Process process;
+    private BinaryWriter writer;
+    private BinaryReader reader;
+
+    public BackendServer(string exePath) {
+        ProcessStartInfo startInfo = new ProcessStartInfo();
+        startInfo.FileName = exePath;
+        startInfo.Arguments = "-serve";
+        startInfo.RedirectStandardInput = true;
+        startInfo.RedirectStandardOutput = true;
+        startInfo.UseShellExecute = false;
+        startInfo.CreateNoWindow = true;
+        process = Process.Start(startInfo);
+        writer = new BinaryWriter(process.StandardInput.BaseStream);
+        reader = new BinaryReader(process.StandardOutput.BaseStream);
+    }
+
+    public bool IsAlive { get { return process != null && !process.HasExited; } }
+
+    // Sends "command\nbody"; returns the response body and its status line.
+    // UTF-8 like the source files the backend used to read, so db strings
+    // keep their bytes.
+    public string Request(string command, string body, out string status) {
+        byte[] payload = Encoding.UTF8.GetBytes(command + "\n" + body);
+        writer.Write(payload.Length); // Little-endian u32
+        writer.Write(payload);
+        writer.Flush();
+
+        int length = reader.ReadInt32();
+        string response = Encoding.UTF8.GetString(reader.ReadBytes(length));
+        int eol = response.IndexOf('\n');
+        status = eol < 0 ? response : response.Substring(0, eol);
+        return eol < 0 ? "" : response.Substring(eol + 1);
+    }
+
+    public void Dispose() {
+        if (IsAlive) {
+            try {
+                string status;
+                Request("quit", "", out status);
+                process.WaitForExit(1000);
+            } catch {}
+            if (!process.HasExited) process.Kill();
+        }
+    }
+}
+
 public class AssemblerGUI : Form
 {
     private RichTextBox inputTextBox; 
@@ -15,9 +67,13 @@ public class AssemblerGUI : Form
     private SplitContainer splitContainer;
     private bool isHighlighting = false;
 
+    // Backend kept running between assembles
+    private BackendServer backend;
+
     // Debugger Controls
     private Process debugProcess;
-    private Button debugButton, stepButton, stopButton;
+    private Button debugButton, stepButton, stepBackButton, continueButton, stopButton, breakButton;
+    private TextBox breakpointBox;
     private Label axLabel, bxLabel, cxLabel, dxLabel, spLabel, ipLabel;
 
     public AssemblerGUI()
@@ -79,14 +135,30 @@ public class AssemblerGUI : Form
         debugPanel.Controls.Add(spLabel);
         debugPanel.Controls.Add(ipLabel);
 
-        stepButton = new Button() { Text = "Step Into", Top = 250, Left = 10, Width = 180, Height = 40, BackColor = Color.Yellow, Enabled = false };
+        stepButton = new Button() { Text = "Step Into", Top = 250, Left = 10, Width = 88, Height = 40, BackColor = Color.Yellow, Enabled = false };
         stepButton.Click += (s, ev) => SendDebugCommand("s");
         debugPanel.Controls.Add(stepButton);
 
-        stopButton = new Button() { Text = "Stop", Top = 300, Left = 10, Width = 180, Height = 40, BackColor = Color.Red, Enabled = false };
+        stepBackButton = new Button() { Text = "Step Back", Top = 250, Left = 102, Width = 88, Height = 40, BackColor = Color.Khaki, Enabled = false };
+        stepBackButton.Click += (s, ev) => SendDebugCommand("rs");
+        debugPanel.Controls.Add(stepBackButton);
+
+        continueButton = new Button() { Text = "Continue", Top = 300, Left = 10, Width = 180, Height = 40, BackColor = Color.LightGreen, Enabled = false };
+        continueButton.Click += (s, ev) => SendDebugCommand("c");
+        debugPanel.Controls.Add(continueButton);
+
+        stopButton = new Button() { Text = "Stop", Top = 350, Left = 10, Width = 180, Height = 40, BackColor = Color.Red, Enabled = false };
         stopButton.Click += (s, ev) => StopDebug();
         debugPanel.Controls.Add(stopButton);
 
+        // Breakpoint entry: "<hex address> [condition]", e.g. "010B CL==3"
+        breakpointBox = new TextBox() { Top = 400, Left = 10, Width = 180, Font = new Font("Consolas", 10) };
+        debugPanel.Controls.Add(breakpointBox);
+
+        breakButton = new Button() { Text = "Set Breakpoint", Top = 430, Left = 10, Width = 180, Height = 30, BackColor = Color.Orange, Enabled = false };
+        breakButton.Click += (s, ev) => { if (breakpointBox.Text.Trim().Length > 0) SendDebugCommand("b " + breakpointBox.Text.Trim()); };
+        debugPanel.Controls.Add(breakButton);
+
         // Controls Panel (Bottom)
         Panel bottomPanel = new Panel();
         bottomPanel.Height = 50;
@@ -144,6 +216,8 @@ public class AssemblerGUI : Form
         
         // Initial Highlight
         HighlightSyntax();
+
+        this.FormClosed += (s, ev) => { if (backend != null) backend.Dispose(); };
     }
 
     private Label CreateRegLabel(string text, int top) {
@@ -168,10 +242,13 @@ public class AssemblerGUI : Form
         debugProcess = new Process();
         debugProcess.StartInfo = startInfo;
         debugProcess.OutputDataReceived += DebugOutputHandler;
-        debugProcess.BeginOutputReadLine(); // Async read
         debugProcess.Start();
+        debugProcess.BeginOutputReadLine(); // Async read; only valid once started
 
         stepButton.Enabled = true;
+        stepBackButton.Enabled = true;
+        continueButton.Enabled = true;
+        breakButton.Enabled = true;
         stopButton.Enabled = true;
         statusLabel.Text = "Debugging Started...";
     }
@@ -185,6 +262,9 @@ public class AssemblerGUI : Form
             if (!debugProcess.HasExited) debugProcess.Kill();
         }
         stepButton.Enabled = false;
+        stepBackButton.Enabled = false;
+        continueButton.Enabled = false;
+        breakButton.Enabled = false;
         stopButton.Enabled = false;
         statusLabel.Text = "Debugging Stopped.";
     }
@@ -197,22 +277,31 @@ public class AssemblerGUI : Form
 
     private void DebugOutputHandler(object sendingProcess, DataReceivedEventArgs outLine) {
         if (String.IsNullOrEmpty(outLine.Data)) return;
-        string line = outLine.Data.Trim();
-        // Parse DEBUG|IP|AX...
-        if (line.StartsWith("DEBUG|")) {
-            string[] parts = line.Split('|');
-            // Update UI (Invoke required)
-            this.Invoke((MethodInvoker)delegate {
-                if (parts.Length > 6) {
-                    ipLabel.Text = "IP: " + parts[1];
-                    axLabel.Text = "AX: " + parts[2];
-                    bxLabel.Text = "BX: " + parts[3];
-                    cxLabel.Text = "CX: " + parts[4];
-                    dxLabel.Text = "DX: " + parts[5];
-                    spLabel.Text = "SP: " + parts[6];
-                }
-            });
-        }
+        // The backend reports only at stop points: DEBUG|IP|AX|BX|CX|DX|SP|ZF|reason.
+        // Program output may precede it on the same line.
+        int start = outLine.Data.IndexOf("DEBUG|");
+        if (start < 0) return;
+        string[] parts = outLine.Data.Substring(start).Trim().Split('|');
+        // Update UI (Invoke required)
+        this.Invoke((MethodInvoker)delegate {
+            if (parts.Length > 6) {
+                ipLabel.Text = "IP: " + parts[1];
+                axLabel.Text = "AX: " + parts[2];
+                bxLabel.Text = "BX: " + parts[3];
+                cxLabel.Text = "CX: " + parts[4];
+                dxLabel.Text = "DX: " + parts[5];
+                spLabel.Text = "SP: " + parts[6];
+            }
+            if (parts.Length > 8 && (parts[8] == "break" || parts[8] == "watch")) {
+                statusLabel.Text = "Stopped at " + (parts[8] == "break" ? "breakpoint" : "watchpoint") + ", IP " + parts[1];
+            }
+            if (parts.Length > 8 && (parts[8] == "halt" || parts[8] == "limit")) {
+                stepButton.Enabled = false;
+                stepBackButton.Enabled = false;
+                continueButton.Enabled = false;
+                statusLabel.Text = parts[8] == "halt" ? "Program finished." : "Cycle limit reached.";
+            }
+        });
     }
 
     private void Input_TextChanged(object sender, EventArgs e) {
@@ -231,7 +320,7 @@ public class AssemblerGUI : Form
         inputTextBox.SelectionFont = new Font(inputTextBox.Font, FontStyle.Regular);
 
         // Keywords
-        string keywords = @"\b(LOAD|STORE|ADD|SUB|MULT|DIV|JMP|JZ|JNZ|HALT|ORG|DW|DB|MACRO|MEND|mov|printn|int|push|pop|call|ret|proc|endp)\b";
+        string keywords = @"\b(LOAD|STORE|ADD|SUB|MULT|DIV|JMP|JZ|JNZ|J[A-Z]{1,3}|HALT|ORG|DW|DB|MACRO|MEND|mov|printn|int|push|pop|pushf|popf|call|ret|proc|endp)\b";
         MatchCollection keywordMatches = Regex.Matches(inputTextBox.Text, keywords, RegexOptions.IgnoreCase);
         foreach (Match m in keywordMatches) {
             inputTextBox.Select(m.Index, m.Length);
@@ -298,51 +387,39 @@ public class AssemblerGUI : Form
 
     private void AssembleButton_Click(object sender, EventArgs e)
     {
-        string inputPath = "temp.asm";
         string outputPath = "result.obj";
         string exePath = "TitanASM.exe"; 
 
-        try {
-            File.WriteAllText(inputPath, inputTextBox.Text); 
-        } catch (Exception ex) {
-            MessageBox.Show("Error saving temp file: " + ex.Message);
-            return;
-        }
-
         if (!File.Exists(exePath)) {
             MessageBox.Show("Error: TitanASM.exe not found!");
             return;
         }
 
-        ProcessStartInfo startInfo = new ProcessStartInfo();
-        startInfo.FileName = exePath;
-        startInfo.Arguments = "\"" + inputPath + "\" \"" + outputPath + "\"";
-        startInfo.RedirectStandardOutput = true;
-        startInfo.RedirectStandardError = true;
-        startInfo.UseShellExecute = false;
-        startInfo.CreateNoWindow = true;
-
         try {
-            using (Process process = Process.Start(startInfo)) {
-                process.WaitForExit();
-                string output = process.StandardOutput.ReadToEnd();
-                string error = process.StandardError.ReadToEnd();
-
-                if (process.ExitCode == 0) {
+            if (backend == null || !backend.IsAlive) backend = new BackendServer(exePath);
+
+            string status;
+            string diagnostics = backend.Request("assemble", inputTextBox.Text.Replace("\r\n", "\n"), out status);
+            if (status == "ok") {
+                // Run and Debug still load the object file
+                backend.Request("save " + outputPath, "", out status);
+                if (status == "ok") {
                     statusLabel.Text = "Assembly Success!";
                     statusLabel.ForeColor = Color.Green;
-                    
-                    if (File.Exists(outputPath)) {
-                        outputTextBox.Text = File.ReadAllText(outputPath);
-                    }
                 } else {
-                    statusLabel.Text = "Assembly Failed!";
+                    statusLabel.Text = "Could not write " + outputPath + "!";
                     statusLabel.ForeColor = Color.Red;
-                    outputTextBox.Text = "Error Log:\r\n" + error + "\r\n" + output;
                 }
+                outputTextBox.Text = backend.Request("listing", "", out status).Replace("\n", "\r\n");
+            } else {
+                statusLabel.Text = "Assembly Failed!";
+                statusLabel.ForeColor = Color.Red;
+                outputTextBox.Text = "Error Log:\r\n" + diagnostics.Replace("\n", "\r\n");
             }
         } catch (Exception ex) {
              MessageBox.Show("Error running assembler: " + ex.Message);
+             if (backend != null) backend.Dispose();
+             backend = null;
         }
     }
 
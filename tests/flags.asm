@@ -0,0 +1,134 @@
+org 100h
+.code
+main proc
+    ; Each condition is checked both ways: the jump is taken when it
+    ; holds and its opposite falls through.
+
+    ; Overflow
+    mov al, 7Fh
+    add al, 1       ; 127 + 1: OF
+    jno fail
+    jo of_set
+    jmp fail
+of_set:
+    mov al, 1
+    add al, 1
+    jo fail
+    jno of_clear
+    jmp fail
+of_clear:
+
+    ; Unsigned compares
+    mov al, 5
+    cmp al, 7       ; Borrow: CF
+    jae fail
+    jb below
+    jmp fail
+below:
+    jnc fail
+    jc carry
+    jmp fail
+carry:
+    cmp al, 3
+    jb fail
+    jae above_equal
+    jmp fail
+above_equal:
+    cmp al, 5
+    ja fail
+    jbe below_equal
+    jmp fail
+below_equal:
+    cmp al, 3
+    jbe fail
+    ja above
+    jmp fail
+above:
+
+    ; Sign
+    mov al, 5
+    sub al, 6       ; -1
+    jns fail
+    js sign_set
+    jmp fail
+sign_set:
+    mov al, 5
+    sub al, 4
+    js fail
+    jns sign_clear
+    jmp fail
+sign_clear:
+
+    ; Parity of the low byte
+    mov al, 3
+    add al, 0       ; Two bits set: PF
+    jnp fail
+    jp parity_even
+    jmp fail
+parity_even:
+    mov al, 1
+    add al, 0
+    jp fail
+    jnp parity_odd
+    jmp fail
+parity_odd:
+
+    ; Signed compares disagree with the unsigned ones
+    mov al, 0FEh
+    cmp al, 1       ; -2 < 1, but 254 > 1
+    jge fail
+    jl less
+    jmp fail
+less:
+    jbe fail
+    mov al, 1
+    cmp al, 0FEh    ; 1 >= -2
+    jl fail
+    jge greater_equal
+    jmp fail
+greater_equal:
+    mov al, 80h
+    cmp al, 7Fh     ; -128 <= 127, with OF
+    jg fail
+    jle less_equal
+    jmp fail
+less_equal:
+    mov al, 7Fh
+    cmp al, 80h     ; 127 > -128, with OF
+    jle fail
+    jg greater
+    jmp fail
+greater:
+
+    ; PUSHF/POPF round trip
+    mov al, 5
+    cmp al, 7       ; CF AF SF, PF clear
+    pushf
+    cmp al, al      ; ZF only
+    popf
+    jz fail
+    jnc fail
+    jns fail
+    jp fail
+    pushf
+    pop bx
+    cmp bl, 93h     ; CF AF SF and bit 1
+    jnz fail
+    cmp bh, 0F0h    ; Unused bits read as set
+    jnz fail
+    mov bx, 0F802h  ; OF only
+    push bx
+    popf
+    jno fail
+    jc fail
+
+    printn "Test passed!"
+    mov ah, 4Ch
+    int 21h
+
+fail:
+    printn "Test failed!"
+    mov ah, 4Ch
+    int 21h
+main endp
+end main
@@ -0,0 +1,45 @@
+org 100h
+.code
+main proc
+    ; Run both procedures once so the block and JIT engines compile them
+    mov bx, 0
+    call patch_me
+    call rewrite_me
+    cmp bl, 1
+    jnz fail
+
+    ; Rewrite a compiled byte with its own value: engines drop their code
+    mov al, 1
+    mov rewrite_me, al
+
+    ; Then overwrite patch_me's MOV opcode with ADD (03h). Every engine
+    ; must run the patched code on the next call.
+    mov al, 3
+    mov patch_me, al ; mov bl, 1  ->  add bl, al
+    call patch_me
+    cmp bl, 4        ; 1 + 3
+    jnz fail
+    cmp bh, 0AAh     ; Untouched half ran twice
+    jnz fail
+
+    printn "Test passed!"
+    mov ah, 4Ch
+    int 21h
+
+fail:
+    printn "Test failed!"
+    mov ah, 4Ch
+    int 21h
+main endp
+
+patch_me proc
+    mov bl, 1
+    add bh, 55h
+    ret
+patch_me endp
+
+rewrite_me proc
+    mov cl, 2
+    ret
+rewrite_me endp
+end main
@@ -0,0 +1,69 @@
+org 100h
+.data
+value DB 34h, 12h   ; 1234h
+.code
+main proc
+    ; Immediates keep their high byte
+    mov ax, 0BEEFh
+    cmp ah, 0BEh
+    jnz fail
+    cmp al, 0EFh
+    jnz fail
+
+    ; Carry out of bit 15 and borrow into it
+    mov bx, 0FFF0h
+    add bx, 20h
+    jnc fail
+    cmp bx, 10h
+    jnz fail
+    mov cx, 8000h
+    sub cx, 1
+    jc fail         ; 8000h - 1 does not borrow, but overflows
+    jno fail
+    cmp cx, 7FFFh
+    jnz fail
+    sub cx, bx      ; 7FFFh - 10h
+    cmp cx, 7FEFh
+    jnz fail
+    cmp bx, cx      ; 10h - 7FEFh borrows
+    jnc fail
+    jge fail
+
+    ; Word loads and stores
+    mov ax, value
+    cmp ax, 1234h
+    jnz fail
+    mov ax, 0ABCDh
+    mov value, ax
+    mov bl, value   ; Low byte first
+    cmp bl, 0CDh
+    jnz fail
+
+    ; A word at FFFF wraps to 0000
+    mov ax, 5AA5h
+    mov top_byte, ax
+    mov bl, top_byte
+    cmp bl, 0A5h
+    jnz fail
+    mov bl, bottom_byte
+    cmp bl, 5Ah
+    jnz fail
+    mov cx, top_byte
+    cmp cx, 5AA5h
+    jnz fail
+
+    printn "Test passed!"
+    mov ah, 4Ch
+    int 21h
+
+fail:
+    printn "Test failed!"
+    mov ah, 4Ch
+    int 21h
+main endp
+
+org 0
+bottom_byte:
+org 0FFFFh
+top_byte:
+end main
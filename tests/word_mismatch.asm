@@ -0,0 +1,13 @@
+org 100h
+; Must not assemble: every instruction mixes 8- and 16-bit registers.
+; Expected: "Operand size mismatch" for lines 6 to 9.
+.code
+main proc
+    mov ax, bl
+    add bx, cl
+    sub cl, dx
+    cmp ah, cx
+    mov ah, 4Ch
+    int 21h
+main endp
+end main